@@ -51,6 +51,7 @@ public:
 		this->acceptanceMechanism = acceptanceMechanism;
 
 		showInformationPeriod = 0;
+		stallIterationLimit = 0;
 	}
 
 	void perturbInNeighbour(double* x_s, double* x_new, double* neighbourDirection, double temperature)
@@ -172,7 +173,7 @@ public:
 		double E_s = initialError;
 
 		const int maximumIteration = (dimension * iterationPerDimension);
-		const int stallIterationLimit = (maximumIteration / 5);
+		const int stallIterationLimit = (this->stallIterationLimit > 0 ? this->stallIterationLimit : maximumIteration / 5);
 		int stallIterationCounter = 0;
 
 		int iteration;
@@ -246,6 +247,12 @@ public:
 		this->showInformationPeriod = showInformationPeriod;
 	}
 
+	// iterations without a change of the energy that stop the annealing (0 : a fifth of the maximum iteration count)
+	void setStallIterationLimit(int stallIterationLimit)
+	{
+		this->stallIterationLimit = stallIterationLimit;
+	}
+
 private:
 	double initialTemperature;
 	int iterationPerDimension;
@@ -262,5 +269,6 @@ private:
 	double upperBound;
 
 	int showInformationPeriod;
+	int stallIterationLimit;
 
 };
@@ -4,6 +4,7 @@
 #include <windows.h>
 #include <opencv2\opencv.hpp>
 #include "RayleighMixtureSummedAreaTableCFAR.h"
+#include "ScenePipeline.h"
 #include "targetDetectors\AdaptiveAndFastCFAR.h"
 #include "targetDetectors\CellAveragingCFAR.h"
 #include "targetDetectors\AutoCensoredCFAR.h"
@@ -21,29 +22,91 @@ void dummyInitialization()
 	medianBlur(dummyImage, dummyImage, 3);
 }
 
-void detectTargets(TargetDetector targetDetector, string inputFileName, string outputFileName, map<string, double>& parameters, double probabilityOfFalseAlarm = 1e-4, int threadCount = INT_MAX)
+AbstractCFAR* createTargetDetector(TargetDetector targetDetector)
 {
-	AbstractCFAR* CFARtargetDetector = NULL;
 	switch (targetDetector)
 	{
-	case TargetDetectorRmSAT_CFAR	: CFARtargetDetector = new RayleighMixtureSummedAreaTableCFAR;	break;
-	case TargetDetectorAAF_CFAR		: CFARtargetDetector = new AdaptiveAndFastCFAR;					break;
-	case TargetDetectorCA_CFAR		: CFARtargetDetector = new CellAveragingCFAR;					break;
-	case TargetDetectorAC_CFAR		: CFARtargetDetector = new AutoCensoredCFAR;					break;
-	case TargetDetectorVI_CFAR		: CFARtargetDetector = new VariabilityIndexCFAR;				break;
+	case TargetDetectorRmSAT_CFAR	: return new RayleighMixtureSummedAreaTableCFAR;
+	case TargetDetectorAAF_CFAR		: return new AdaptiveAndFastCFAR;
+	case TargetDetectorCA_CFAR		: return new CellAveragingCFAR;
+	case TargetDetectorAC_CFAR		: return new AutoCensoredCFAR;
+	case TargetDetectorVI_CFAR		: return new VariabilityIndexCFAR;
 	default: 
 		cout << "Unknown target detector! (Detector ID=" << targetDetector << ")" << endl;
+		return NULL;
+	}
+}
+
+void detectScene(AbstractCFAR* CFARtargetDetector, SceneJob& scene, map<string, double>& parameters, double probabilityOfFalseAlarm)
+{
+	if (scene.image.empty()) {
+		cout << "Image could not be read! (" << scene.inputFileName << ")" << endl;
+		return;
+	}
+
+	// sparse output, a detection list file (.csv or .bin) instead of a full-size target image
+	if (probabilityOfFalseAlarm > 0.0 && scene.isDetectionList) {
+		scene.detections = CFARtargetDetector->executeDetectionList(scene.image, probabilityOfFalseAlarm, parameters);
+		cout << " Detected target pixel count = " << scene.detections.size() << endl;
+		return;
+	}
+	scene.isDetectionList = false;
+
+	// detect targets, or with a zero Pfa write the per-pixel false alarm probabilities (CV_32F, e.g. tif output) to threshold later
+	scene.targetMap = (probabilityOfFalseAlarm > 0.0 ?
+		CFARtargetDetector->execute(scene.image, probabilityOfFalseAlarm, parameters) :
+		CFARtargetDetector->executeProbabilityMap(scene.image, parameters));
+
+	if (scene.targetMap.empty())
+		cout << "Probability map is not supported by this target detector!" << endl;
+}
+
+void detectTargets(TargetDetector targetDetector, string inputFileName, string outputFileName, map<string, double>& parameters, double probabilityOfFalseAlarm = 1e-4, int threadCount = INT_MAX)
+{
+	AbstractCFAR* CFARtargetDetector = createTargetDetector(targetDetector);
+	if (CFARtargetDetector == NULL) {
 		return;
 	}
 
 	CFARtargetDetector->setThreadCount(threadCount);
 
-	Mat image = imread(inputFileName , CV_LOAD_IMAGE_UNCHANGED);
+	SceneJob scene(inputFileName, outputFileName);
+	ScenePipeline::readScene(scene);
+	detectScene(CFARtargetDetector, scene, parameters, probabilityOfFalseAlarm);
+	ScenePipeline::writeScene(scene);
+
+	delete CFARtargetDetector;
+}
+
+// scene lists (.txt, one file name per line) are processed as a pipeline, the next scenes are read and the previous ones written during a detection
+void detectTargetsInSceneList(TargetDetector targetDetector, string inputListFileName, string outputListFileName, map<string, double>& parameters, double probabilityOfFalseAlarm = 1e-4,
+	int threadCount = INT_MAX, int readerThreadCount = 1, int pipelineQueueLength = 2)
+{
+	vector<string> inputFileNames = ScenePipeline::readSceneList(inputListFileName);
+	vector<string> outputFileNames = ScenePipeline::readSceneList(outputListFileName);
 
-	// detect targets
-	Mat targetMap = CFARtargetDetector->execute(image, probabilityOfFalseAlarm, parameters);
+	if (inputFileNames.empty() || inputFileNames.size() != outputFileNames.size()) {
+		cout << "Scene lists are empty or differ in length! (" << inputListFileName << ", " << outputListFileName << ")" << endl;
+		return;
+	}
+
+	AbstractCFAR* CFARtargetDetector = createTargetDetector(targetDetector);
+	if (CFARtargetDetector == NULL) {
+		return;
+	}
+
+	CFARtargetDetector->setThreadCount(threadCount);
+
+	vector<SceneJob> scenes;
+	for (int i = 0; i < inputFileNames.size(); i++) {
+		scenes.push_back(SceneJob(inputFileNames[i], outputFileNames[i]));
+	}
 
-	imwrite(outputFileName, targetMap);
+	ScenePipeline pipeline(readerThreadCount, pipelineQueueLength);
+	pipeline.run(scenes, [&](SceneJob& scene) {
+		cout << " Scene " << scene.inputFileName << endl;
+		detectScene(CFARtargetDetector, scene, parameters, probabilityOfFalseAlarm);
+	});
 
 	delete CFARtargetDetector;
 }
@@ -93,6 +156,8 @@ int _tmain(int argc, _TCHAR* argv[])
 		map<string, double> parameters;
 
 		int threadCount = INT_MAX;
+		int readerThreadCount = 1;
+		int pipelineQueueLength = 2;
 		const int parameterCount = (argc - (minimumArgumentCount - 1)) / 2;
 		for (int i = 0; i < parameterCount; i++) {
 			string key = string(argv[minimumArgumentCount + 2 * i]);
@@ -100,6 +165,10 @@ int _tmain(int argc, _TCHAR* argv[])
 
 			if (key == "ThreadCount")
 				threadCount = (int)value;
+			else if (key == "ReaderThreadCount")
+				readerThreadCount = (int)value;
+			else if (key == "PipelineQueueLength")
+				pipelineQueueLength = (int)value;
 			else {
 				parameters[key] = value;
 				cout << " " << key << " = " << value << endl;
@@ -108,19 +177,47 @@ int _tmain(int argc, _TCHAR* argv[])
 
 		cout << " Thread count = " << (threadCount == INT_MAX ? omp_get_max_threads() : threadCount) << endl;
 
-		detectTargets(targetDetector, inputFileName, outputFileName, parameters, probabilityOfFalseAlarm, threadCount);
+		if (ScenePipeline::isSceneListFile(inputFileName))
+			detectTargetsInSceneList(targetDetector, inputFileName, outputFileName, parameters, probabilityOfFalseAlarm, threadCount, readerThreadCount, pipelineQueueLength);
+		else
+			detectTargets(targetDetector, inputFileName, outputFileName, parameters, probabilityOfFalseAlarm, threadCount);
 	}
 	else {
 		cout << "CFARtargetDetector v1.0" << endl;
 		cout << "CFARtargetDetector  [Input File Name] [Output File Name] [Target Detection Method] [Probability Of False Alarm] [Key1] [Value1] ... [KeyN] [ValueN]" << endl;
-		cout << " Example : CFARtargetDetector  im1024.tif im1024_targets.png RmSAT-CFAR 1e-5 ThreadCount 1 RmSAT-CFAR.guardRadius 10 RmSAT-CFAR.maximumMixtureCount 6" << endl << endl;
+		cout << " Example : CFARtargetDetector  im1024.tif im1024_targets.png RmSAT-CFAR 1e-5 ThreadCount 1 RmSAT-CFAR.guardRadius 10 RmSAT-CFAR.maximumMixtureCount 6" << endl;
+		cout << " Probability Of False Alarm = 0 writes the false alarm probability of every pixel (float image) instead of targets" << endl;
+		cout << " Output File Name with .csv or .bin extension writes the list of target pixels (x, y, value, probability) instead of a target image" << endl;
+		cout << " Input and Output File Names with .txt extension are scene lists (one file name per line), reading, detection and writing of the scenes overlap" << endl;
+		cout << "  (ReaderThreadCount = scenes decoded concurrently, default 1, PipelineQueueLength = scenes queued between the stages, default 2)" << endl << endl;
 
 		cout << "RmSAT-CFAR parameters" << endl;
 		cout << "---------------------" << endl;
 		cout << "RmSAT-CFAR.guardRadius" << endl;
 		cout << "RmSAT-CFAR.clutterRadius" << endl;
 		cout << "RmSAT-CFAR.minimumMixtureCount" << endl;
-		cout << "RmSAT-CFAR.maximumMixtureCount" << endl << endl;
+		cout << "RmSAT-CFAR.maximumMixtureCount" << endl;
+		cout << "RmSAT-CFAR.integralImageLayout  (0 = planar, 1 = interleaved)" << endl;
+		cout << "RmSAT-CFAR.integralImageStorage  (0 = double, 1 = compact)" << endl;
+		cout << "RmSAT-CFAR.validateCompactStorage" << endl;
+		cout << "RmSAT-CFAR.vectorizedDetection  (0 = scalar, 1 = AVX2 on CPUs that support it, default 1)" << endl;
+		cout << "RmSAT-CFAR.exponentialRelativeError  (0 = exact exp, e.g. 1e-4 = table based exp with this relative error)" << endl;
+		cout << "RmSAT-CFAR.prescreening  (0 = off, 1 = skip pixels below a conservative target threshold of their block)" << endl;
+		cout << "RmSAT-CFAR.taskScheduling  (0 = one tile per thread, 1 = tile stages as work-stealing tasks)" << endl;
+		cout << "RmSAT-CFAR.tileOrdering  (0 = raster order, 1 = tiles with the highest estimated cost first)" << endl;
+		cout << "RmSAT-CFAR.logTileCosts  (1 = print estimated and measured cost of every tile)" << endl;
+		cout << "RmSAT-CFAR.occupancyIndex  (0 = process every tile in full, 1 = skip tiles without data and crop the others to their data)" << endl;
+		cout << "RmSAT-CFAR.tileWidth  (0 = tile geometry planned from the caches, threads, mixture count and window radius, tiles of at most 1024 * 1024 pixels within a memory budget, the plan is printed)" << endl;
+		cout << "RmSAT-CFAR.tileHeight  (0 = same as tileWidth)" << endl;
+		cout << "RmSAT-CFAR.tileArena  (0 = heap allocated tile data, 1 = tile data in a per-thread arena reserved once per image)" << endl;
+		cout << "RmSAT-CFAR.largePages  (1 = tile arenas on large pages, needs the Lock pages in memory privilege granted to the user, the arenas that got large pages are printed)" << endl;
+		cout << "RmSAT-CFAR.fittingMode  (0 = every mixture fitted from scratch, 1 = fits warm-started from a neighbouring tile, 2 = fits refined from a fit of the scene histogram, 3 = fits interpolated between anchor tiles)" << endl;
+		cout << "RmSAT-CFAR.warmStartRadius  (warm-start blocks of (2 * radius + 1)^2 tiles around a tile fitted from scratch, default 2)" << endl;
+		cout << "RmSAT-CFAR.anchorSpacing  (distance in tiles between the fitted anchor tiles of fittingMode 3, default 2)" << endl;
+		cout << "RmSAT-CFAR.interpolationMargin  (cost above the worse anchor up to which an interpolated fit is taken without annealing, default 0.1)" << endl;
+		cout << "RmSAT-CFAR.fitCacheTolerance  (0 = fit every tile, e.g. 0.05 = tiles with histogram percentiles and moments equal up to 5% reuse a fit, the reused fit depends on the thread scheduling)" << endl;
+		cout << "RmSAT-CFAR.quadtreeLevels  (0 = tiles of the tile size, e.g. 2 = tiles from 1/4 up to 4 times the tile size by clutter homogeneity, clamped to cells of at least the band size and 256 * 256 pixels)" << endl;
+		cout << "RmSAT-CFAR.quadtreeTolerance  (range of the log median and log(p90 / p50) of the cells merged into a quadtree tile, default 0.2)" << endl << endl;
 
 		cout << "AAF-CFAR parameters" << endl;
 		cout << "-------------------" << endl;
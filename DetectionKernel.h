@@ -0,0 +1,36 @@
+#pragma once
+
+#include "MathUtilities.h"
+
+
+// SAT rows of the window (w) and guard (g) box corners for one expansion of one image row
+template<typename TI2, typename TC>
+struct SummedAreaTableRows {
+	TI2* I2w1;
+	TI2* I2w2;
+	TI2* I2g1;
+	TI2* I2g2;
+	TC* Cw1;
+	TC* Cw2;
+	TC* Cg1;
+	TC* Cg2;
+};
+
+// constants of the detection kernel for one tile (or stream)
+struct DetectionKernelParameters {
+	int width;
+	int intervalCount;
+	int pixelStride;
+	int intervalStride;
+	double* weights;
+	int guardRadius;
+	int windowRadius;
+	int minimumClutterArea;
+	double probabilityOfFalseAlarm;
+	const ExponentialTable* exponentialTable;		// NULL : exact exp
+};
+
+// AVX2 kernel of FastTargetDetector::detectRow for double precision SATs, built in its own translation unit with /arch:AVX2 (DetectionKernelAVX2.cpp), so it
+// must only be called if MathUtilities::isAVX2Supported(). pixelValues holds the pixels [x1, x2) of the image row, returns the first pixel that is not processed.
+int detectRowAVX2(const DetectionKernelParameters& kernelParameters, int maximumExpansion, const double* pixelValues, unsigned char* trow, int x1, int x2,
+	SummedAreaTableRows<double, int>* satRows, int& targetCount, int& expansionCount, const double* prescreenThresholds);
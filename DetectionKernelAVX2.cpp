@@ -0,0 +1,197 @@
+#include <climits>
+#include <immintrin.h>
+#include "DetectionKernel.h"
+
+// Compiled with /arch:AVX2 (see the project files), so nothing in here may run on a CPU without AVX2. Besides the ExponentialTable accessors (no floating
+// point code) only functions of this file are called, so the linker cannot pick an AVX2 build of an inline function shared with the other translation units.
+
+
+// exp(x) of 4 doubles, x = n * ln(2) + r with |r| <= ln(2) / 2 and exp(r) by its degree 11 Taylor polynomial (relative error < 1e-14),
+// arguments are clamped to [-708, 709] so that 2^n stays a normal double
+static inline __m256d vectorExp(__m256d x)
+{
+	x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-708.0)), _mm256_set1_pd(709.0));
+
+	const __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+	// ln(2) is split into an exactly representable high part and a low part
+	__m256d r = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(6.93145751953125e-1)));
+	r = _mm256_sub_pd(r, _mm256_mul_pd(n, _mm256_set1_pd(1.42860682030941723212e-6)));
+
+	__m256d p = _mm256_set1_pd(1.0 / 39916800.0);
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 3628800.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 362880.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 40320.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 5040.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 720.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 120.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 24.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0 / 6.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(0.5));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0));
+	p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(1.0));
+
+	// 2^n by writing n + 1023 into the exponent bits
+	const __m256i exponent = _mm256_slli_epi64(_mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n)), _mm256_set1_epi64x(1023)), 52);
+
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+}
+
+// exp(-t) of 4 doubles, t >= 0 (see ExponentialTable::negativeExp)
+static inline __m256d vectorNegativeExp(const ExponentialTable& exponentialTable, __m256d t)
+{
+	const double maximumExponent = 1021.0;
+
+	const __m256d u = _mm256_mul_pd(t, _mm256_set1_pd(1.4426950408889634));
+	const __m256d isInRange = _mm256_cmp_pd(u, _mm256_set1_pd(maximumExponent), _CMP_LT_OQ);
+	const __m256d uClamped = _mm256_min_pd(u, _mm256_set1_pd(maximumExponent));
+
+	const __m256d n = _mm256_floor_pd(uClamped);
+	const __m256d position = _mm256_mul_pd(_mm256_sub_pd(uClamped, n), _mm256_set1_pd(exponentialTable.getTableSize()));
+	const __m256d index = _mm256_floor_pd(position);
+	const __m256d weight = _mm256_sub_pd(position, index);
+
+	const __m128i tableIndex = _mm256_cvttpd_epi32(index);
+	const __m256d p0 = _mm256_i32gather_pd(exponentialTable.getTable(), tableIndex, 8);
+	const __m256d p1 = _mm256_i32gather_pd(exponentialTable.getTable() + 1, tableIndex, 8);
+	const __m256d p = _mm256_add_pd(p0, _mm256_mul_pd(weight, _mm256_sub_pd(p1, p0)));
+
+	const __m256i scaleBits = _mm256_slli_epi64(_mm256_sub_epi64(_mm256_set1_epi64x(1023), _mm256_cvtepi32_epi64(_mm256_cvttpd_epi32(n))), 52);
+
+	return _mm256_and_pd(_mm256_mul_pd(p, _mm256_castsi256_pd(scaleBits)), isInRange);
+}
+
+static inline int countLanes(int laneMask)
+{
+	return (laneMask & 1) + ((laneMask >> 1) & 1) + ((laneMask >> 2) & 1) + ((laneMask >> 3) & 1);
+}
+
+// The pixels that pass the pre-screening are compacted first and taken 4 at a time, so the lanes stay busy even if most pixels are screened out. SAT
+// corners are gathered and the early-exit of the scalar kernel is replaced by lane masks (lanes that are already decided are masked out).
+int detectRowAVX2(const DetectionKernelParameters& kernelParameters, int maximumExpansion, const double* pixelValues, unsigned char* trow, int x1, int x2,
+	SummedAreaTableRows<double, int>* satRows, int& targetCount, int& expansionCount, const double* prescreenThresholds)
+{
+	const int laneCount = 4;
+	const int chunkSize = 256;
+
+	const int intervalCount = kernelParameters.intervalCount;
+	const int intervalStride = kernelParameters.intervalStride;
+	const double* weights = kernelParameters.weights;
+	const int windowRadius = kernelParameters.windowRadius;
+	const ExponentialTable* exponentialTable = kernelParameters.exponentialTable;
+
+	const __m128i zeroIndex = _mm_setzero_si128();
+	const __m128i laneIndices = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i lastColumn = _mm_set1_epi32(kernelParameters.width - 1);
+	const __m128i pixelStride = _mm_set1_epi32(kernelParameters.pixelStride);
+	const __m128i guardRadius = _mm_set1_epi32(kernelParameters.guardRadius);
+
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d minusHalf = _mm256_set1_pd(-0.5);
+	const double minimumTargetValue = 1.0;
+	const __m256d minimumClutterArea = _mm256_set1_pd(kernelParameters.minimumClutterArea);
+	const __m256d probabilityOfFalseAlarm = _mm256_set1_pd(kernelParameters.probabilityOfFalseAlarm);
+
+	// candidate pixels of a chunk, padded to full lanes
+	int candidates[chunkSize + laneCount];
+
+	for (int chunkStart = x1; chunkStart < x2; chunkStart += chunkSize) {
+		const int chunkEnd = (chunkStart + chunkSize < x2 ? chunkStart + chunkSize : x2);
+
+		// pre-screened (or no data) pixels need no SAT access at all
+		int candidateCount = 0;
+		for (int x = chunkStart; x < chunkEnd; x++) {
+			const double pixelValue = pixelValues[x - x1];
+
+			trow[x] = 0;
+			candidates[candidateCount] = x;
+			candidateCount += (pixelValue >= minimumTargetValue && (prescreenThresholds == NULL || pixelValue > prescreenThresholds[x]) ? 1 : 0);
+		}
+
+		for (int c = 0; c < candidateCount; c += laneCount) {
+			const int activeLaneCount = (candidateCount - c < laneCount ? candidateCount - c : laneCount);
+			for (int lane = activeLaneCount; lane < laneCount; lane++) {
+				candidates[c + lane] = candidates[c];
+			}
+
+			const __m128i xs = _mm_loadu_si128((const __m128i*)(candidates + c));
+			const __m256d pixelValue = _mm256_i32gather_pd(pixelValues, _mm_sub_epi32(xs, _mm_set1_epi32(x1)), 8);
+			const __m256d pixelValueSqr = _mm256_mul_pd(pixelValue, pixelValue);
+
+			__m256d undecided = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmplt_epi32(laneIndices, _mm_set1_epi32(activeLaneCount))));
+			__m256d isTarget = zero;
+
+			const __m128i gx1 = _mm_mullo_epi32(_mm_max_epi32(_mm_sub_epi32(xs, guardRadius), zeroIndex), pixelStride);
+			const __m128i gx2 = _mm_mullo_epi32(_mm_min_epi32(_mm_add_epi32(xs, guardRadius), lastColumn), pixelStride);
+
+			for (int expansion = 1; expansion < maximumExpansion && _mm256_movemask_pd(undecided) != 0; expansion++) {
+				const SummedAreaTableRows<double, int>& rows = satRows[expansion];
+
+				const __m128i radius = _mm_set1_epi32(expansion * windowRadius);
+				const __m128i wx1 = _mm_mullo_epi32(_mm_max_epi32(_mm_sub_epi32(xs, radius), zeroIndex), pixelStride);
+				const __m128i wx2 = _mm_mullo_epi32(_mm_min_epi32(_mm_add_epi32(xs, radius), lastColumn), pixelStride);
+
+				__m256d probabilitySum = zero;
+				__m256d clutterArea = zero;
+
+				int intervalShift = 0;
+				for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+					const int* Cw1 = rows.Cw1 + intervalShift;
+					const int* Cw2 = rows.Cw2 + intervalShift;
+					const int* Cg1 = rows.Cg1 + intervalShift;
+					const int* Cg2 = rows.Cg2 + intervalShift;
+
+					const __m128i sumCw = _mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(_mm_i32gather_epi32(Cw1, wx1, 4), _mm_i32gather_epi32(Cw2, wx2, 4)), _mm_i32gather_epi32(Cw1, wx2, 4)), _mm_i32gather_epi32(Cw2, wx1, 4));
+					const __m128i sumCg = _mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(_mm_i32gather_epi32(Cg1, gx1, 4), _mm_i32gather_epi32(Cg2, gx2, 4)), _mm_i32gather_epi32(Cg1, gx2, 4)), _mm_i32gather_epi32(Cg2, gx1, 4));
+					const __m256d sumC = _mm256_cvtepi32_pd(_mm_sub_epi32(sumCw, sumCg));
+
+					const __m256d hasClutter = _mm256_and_pd(_mm256_cmp_pd(sumC, zero, _CMP_GT_OQ), undecided);
+					if (_mm256_movemask_pd(hasClutter) != 0) {
+						const double* I2w1 = rows.I2w1 + intervalShift;
+						const double* I2w2 = rows.I2w2 + intervalShift;
+						const double* I2g1 = rows.I2g1 + intervalShift;
+						const double* I2g2 = rows.I2g2 + intervalShift;
+
+						const __m256d sumI2w = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_i32gather_pd(I2w1, wx1, 8), _mm256_i32gather_pd(I2w2, wx2, 8)), _mm256_i32gather_pd(I2w1, wx2, 8)), _mm256_i32gather_pd(I2w2, wx1, 8));
+						const __m256d sumI2g = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_i32gather_pd(I2g1, gx1, 8), _mm256_i32gather_pd(I2g2, gx2, 8)), _mm256_i32gather_pd(I2g1, gx2, 8)), _mm256_i32gather_pd(I2g2, gx1, 8));
+						const __m256d sumI2 = _mm256_sub_pd(sumI2w, sumI2g);
+
+						// lanes without clutter divide by one and are masked out afterwards
+						const __m256d sigmaSqr = _mm256_div_pd(_mm256_mul_pd(half, sumI2), _mm256_blendv_pd(one, sumC, hasClutter));
+						const __m256d safeSigmaSqr = _mm256_blendv_pd(one, sigmaSqr, hasClutter);
+						const __m256d RayleighProbability = (exponentialTable != NULL ? vectorNegativeExp(*exponentialTable, _mm256_div_pd(_mm256_mul_pd(half, pixelValueSqr), safeSigmaSqr))
+							: vectorExp(_mm256_div_pd(_mm256_mul_pd(minusHalf, pixelValueSqr), safeSigmaSqr)));
+
+						probabilitySum = _mm256_add_pd(probabilitySum, _mm256_and_pd(_mm256_mul_pd(_mm256_set1_pd(weights[intervalIndex]), RayleighProbability), hasClutter));
+						clutterArea = _mm256_add_pd(clutterArea, _mm256_and_pd(sumC, hasClutter));
+
+						// early-exit when all undecided lanes are certainly not targets
+						const __m256d isNotTarget = _mm256_and_pd(_mm256_cmp_pd(clutterArea, minimumClutterArea, _CMP_GE_OQ), _mm256_cmp_pd(probabilitySum, probabilityOfFalseAlarm, _CMP_GT_OQ));
+						if (_mm256_movemask_pd(_mm256_andnot_pd(isNotTarget, undecided)) == 0) {
+							break;
+						}
+					}
+
+					intervalShift += intervalStride;
+				}
+
+				// target decision rule
+				const __m256d isDecided = _mm256_and_pd(_mm256_cmp_pd(clutterArea, minimumClutterArea, _CMP_GE_OQ), undecided);
+				isTarget = _mm256_or_pd(isTarget, _mm256_and_pd(isDecided, _mm256_cmp_pd(probabilitySum, probabilityOfFalseAlarm, _CMP_LT_OQ)));
+
+				undecided = _mm256_andnot_pd(isDecided, undecided);
+				expansionCount += countLanes(_mm256_movemask_pd(undecided));
+			}
+
+			const int targetLanes = _mm256_movemask_pd(isTarget);
+			for (int lane = 0; lane < activeLaneCount; lane++) {
+				trow[candidates[c + lane]] = ((targetLanes >> lane) & 1 ? UCHAR_MAX : 0);
+			}
+			targetCount += countLanes(targetLanes);
+		}
+	}
+
+	return x2;
+}
@@ -8,10 +8,14 @@
 using namespace std;
 using namespace cv;
 
+enum FittingMode { FittingCold, FittingWarmStart, FittingSceneRefinement, FittingAnchorInterpolation };			// default : FittingCold
+
 class DetermineMixtureParameters {
 public:
+	// x_seed : solution of a similar tile (e.g. a neighbour, see RayleighMixtureData::solution), if it is a valid mixture of this tile the annealing
+	// starts from it with a lower temperature and a shorter stall limit instead of the full schedule from the default intervals
 	template<typename T>
-	static void set(RayleighMixtureData& rayleighMixtureData, int minimumMixtureCount)
+	static void set(RayleighMixtureData& rayleighMixtureData, int minimumMixtureCount, const double* x_seed = NULL)
 	{
 		if (rayleighMixtureData.dimension == 1) {
 			// single Rayleigh
@@ -30,6 +34,7 @@ public:
 			rayleighMixtureData.initialError = 0.0;
 			rayleighMixtureData.finalError = 0.0;
 			rayleighMixtureData.iterationCount = 0;
+			rayleighMixtureData.solution.clear();
 		}
 		else {
 			// mixture of Rayleigh
@@ -45,16 +50,68 @@ public:
 
 			rayleighMixtureData.initialError = rmCostFunction.evaluate(x_initial);
 
-			const double initialTemperature = 250;
-			const int iterationPerDimension = 1000;
+			// the seed is only used if it fits this tile better than the default intervals
+			bool isWarmStart = false;
+			if (x_seed != NULL) {
+				Mat seed(rayleighMixtureData.dimension, 1, CV_64FC1, (void*)x_seed);
+				const double seedError = rmCostFunction.evaluate((double*)seed.data);
+
+				if (seedError < rayleighMixtureData.initialError) {
+					seed.copyTo(x);
+					rayleighMixtureData.initialError = seedError;
+					isWarmStart = true;
+				}
+			}
+
+			const double initialTemperature = (isWarmStart ? 5 : 250);
+			const int iterationPerDimension = (isWarmStart ? 60 : 1000);
 			const double convergenceTolerance = 1e-4;
 			AdaptiveSimulatedAnnealing asa(initialTemperature, iterationPerDimension, convergenceTolerance);
+			if (isWarmStart) {
+				asa.setStallIterationLimit(rayleighMixtureData.dimension * 10);
+			}
 
 			SAOptimimumSolution optimimumSolution = asa.minimize(rmCostFunction, x_initial);
 			rayleighMixtureData.finalError = rmCostFunction.evaluate(optimimumSolution.x_optimum);
 
 			rayleighMixtureData.iterationCount = optimimumSolution.iteration;
+
+			if (optimimumSolution.optimumCostValue < numeric_limits<double>::infinity()) {
+				rayleighMixtureData.solution.assign(optimimumSolution.x_optimum, optimimumSolution.x_optimum + rayleighMixtureData.dimension);
+			}
+			else {
+				rayleighMixtureData.solution.clear();
+			}
+		}
+	}
+
+	// takes the annealing variables of an earlier fit (e.g. of a tile with the same histogram signature, see MixtureFitCache) without annealing,
+	// false if they are not a valid mixture of this data
+	template<typename T>
+	static bool apply(RayleighMixtureData& rayleighMixtureData, int minimumMixtureCount, const vector<double>& solution)
+	{
+		if (rayleighMixtureData.dimension == 1 || solution.size() != rayleighMixtureData.dimension) {
+			return false;
 		}
+
+		const double lowerBoundPercentage = 1.0;
+		const double upperBoundPercentage = 99.0;
+		RayleighMixtureCostFunction<T> rmCostFunction(rayleighMixtureData, minimumMixtureCount);
+		rmCostFunction.setLowerBound(lowerBoundPercentage);
+		rmCostFunction.setUpperBound(upperBoundPercentage);
+
+		vector<double> x = solution;
+		const double error = rmCostFunction.evaluate(&x[0]);
+		if (!(error < numeric_limits<double>::infinity())) {
+			return false;
+		}
+
+		rayleighMixtureData.initialError = error;
+		rayleighMixtureData.finalError = error;
+		rayleighMixtureData.iterationCount = 0;
+		rayleighMixtureData.solution = solution;
+
+		return true;
 	}
 
 private:
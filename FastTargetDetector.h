@@ -4,6 +4,8 @@
 #include "RayleighMixtureData.h"
 #include "IntegralImageData.h"
 #include "MathUtilities.h"
+#include "DetectionKernel.h"
+#include "targetDetectors\TargetDetectionList.h"
 
 using namespace std;
 using namespace cv;
@@ -26,6 +28,10 @@ public:
 	FastTargetDetector(int maximumExpansion = 4)
 	{
 		this->maximumExpansion = maximumExpansion;
+		this->isVectorized = true;
+		this->exponentialTable = NULL;
+		this->isPrescreened = true;
+		this->threadCount = 1;
 	}
 
 	int getMaximumExpansion() const
@@ -33,107 +39,488 @@ public:
 		return maximumExpansion;
 	}
 
-	int setMaximumExpansion(int maximumExpansion)
+	void setMaximumExpansion(int maximumExpansion)
 	{
 		this->maximumExpansion = maximumExpansion;
 	}
 
+	// the vectorized kernel needs a CPU with AVX2 and is used for double precision SATs (StorageDouble)
+	void setVectorization(bool isVectorized)
+	{
+		this->isVectorized = isVectorized;
+	}
+
+	bool getVectorization() const
+	{
+		return isVectorized;
+	}
+
+	// approximate exp with a bounded relative error for the Rayleigh tail probabilities (NULL : exact exp)
+	void setExponentialTable(const ExponentialTable* exponentialTable)
+	{
+		this->exponentialTable = exponentialTable;
+	}
+
+	const ExponentialTable* getExponentialTable() const
+	{
+		return exponentialTable;
+	}
+
+	// pixels below the pre-screening threshold of their block are set to non-target without any SAT access (results are unchanged)
+	void setPrescreening(bool isPrescreened)
+	{
+		this->isPrescreened = isPrescreened;
+	}
+
+	bool getPrescreening() const
+	{
+		return isPrescreened;
+	}
+
+	// rows of the working rectangle are split over threadCount threads (nested region if called from a parallel region), results are unchanged
+	void setThreadCount(int threadCount)
+	{
+		this->threadCount = max(threadCount, 1);
+	}
+
+	int getThreadCount() const
+	{
+		return threadCount;
+	}
+
 	TargetDetectionInformation execute(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, double probabilityOfFalseAlarm, Mat& targetMap, Rect workingRect)
 	{
-		Mat& image = rayleighMixtureData.image;
+		if (integralImageData.storage == StorageCompact) {
+			if (integralImageData.C.type() == CV_16UC1)
+				return detectTargets<unsigned int, unsigned short>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm, targetMap, workingRect);
+			else
+				return detectTargets<unsigned int, unsigned int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm, targetMap, workingRect);
+		}
+		else {
+			return detectTargets<double, int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm, targetMap, workingRect);
+		}
+	}
+
+	// per-pixel false alarm probability (CV_32F), see calculateProbabilityRow
+	void executeProbabilityMap(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, Mat& probabilityMap, Rect workingRect)
+	{
+		if (integralImageData.storage == StorageCompact) {
+			if (integralImageData.C.type() == CV_16UC1)
+				calculateProbabilities<unsigned int, unsigned short>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityMap, workingRect);
+			else
+				calculateProbabilities<unsigned int, unsigned int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityMap, workingRect);
+		}
+		else {
+			calculateProbabilities<double, int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityMap, workingRect);
+		}
+	}
+
+	// target pixels of targetMap (result of execute) within workingRect with their false alarm probability, appended in tile coordinates
+	void appendDetections(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, Mat& targetMap, Rect workingRect,
+		vector<TargetDetection>& detections)
+	{
+		if (integralImageData.storage == StorageCompact) {
+			if (integralImageData.C.type() == CV_16UC1)
+				collectDetections<unsigned int, unsigned short>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, targetMap, workingRect, detections);
+			else
+				collectDetections<unsigned int, unsigned int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, targetMap, workingRect, detections);
+		}
+		else {
+			collectDetections<double, int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, targetMap, workingRect, detections);
+		}
+	}
+
+	// Rayleigh sigma of the clutter pooled over all intervals in the window of the first expansion with enough clutter (as used by the decision of (x, y)),
+	// 0 if there is not enough clutter
+	double calculateClutterSigma(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, int x, int y)
+	{
+		if (integralImageData.storage == StorageCompact) {
+			if (integralImageData.C.type() == CV_16UC1)
+				return calculateClutterSigma<unsigned int, unsigned short>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, x, y);
+			else
+				return calculateClutterSigma<unsigned int, unsigned int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, x, y);
+		}
+		else {
+			return calculateClutterSigma<double, int>(rayleighMixtureData, integralImageData, guardRadius, windowRadius, x, y);
+		}
+	}
+
+	static DetectionKernelParameters createKernelParameters(RayleighMixtureData& rayleighMixtureData, int width, int pixelStride, int intervalStride, int guardRadius, int windowRadius, double probabilityOfFalseAlarm)
+	{
+		DetectionKernelParameters kernelParameters;
+		kernelParameters.width = width;
+		kernelParameters.intervalCount = rayleighMixtureData.intervalCount;
+		kernelParameters.pixelStride = pixelStride;
+		kernelParameters.intervalStride = intervalStride;
+		kernelParameters.weights = rayleighMixtureData.Weights;
+		kernelParameters.guardRadius = guardRadius;
+		kernelParameters.windowRadius = windowRadius;
+		kernelParameters.minimumClutterArea = (MathUtilities::sqr(2 * windowRadius + 1) - MathUtilities::sqr(2 * guardRadius + 1)) / 2;
+		kernelParameters.probabilityOfFalseAlarm = probabilityOfFalseAlarm;
+		kernelParameters.exponentialTable = NULL;
+
+		return kernelParameters;
+	}
+
+	// Conservative pre-screening thresholds of blockSize x blockSize pixel blocks (CV_64F, 0 : no pre-screening).
+	// Pixels of interval k are at least L_k (its lower bound), so sigma_k^2 = sum(I^2) / (2 * sum(C)) >= L_k^2 / 2 and the term of interval k is at least
+	// w_k * exp(-v^2 / L_k^2). Every clutter window of every expansion contains the guard ring of the first expansion, so an interval that has a member
+	// in the part of the ring shared by all pixels of a block contributes to every decision of the block, and v <= L_k * sqrt(ln(w_k / Pfa)) means
+	// probabilitySum >= Pfa, i.e. not a target. Only blocks whose windows are not clipped by the tile border are pre-screened.
+	// If region is given, only the blocks overlapping it are evaluated.
+	static Mat createPrescreenThresholdMap(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius,
+		double probabilityOfFalseAlarm, double exponentialRelativeError, int blockSize, Rect region = Rect())
+	{
+		const int width = rayleighMixtureData.image.cols;
+		const int height = rayleighMixtureData.image.rows;
+		const int blockColumnCount = (width + blockSize - 1) / blockSize;
+		const int blockRowCount = (height + blockSize - 1) / blockSize;
+
+		Mat prescreenThresholdMap(blockRowCount, blockColumnCount, CV_64FC1, Scalar(0));
+		if (windowRadius <= guardRadius) {
+			return prescreenThresholdMap;
+		}
+
+		// threshold of each interval, a margin covers the relative error of the evaluated exp and the rounding of the probability sum
 		const int intervalCount = rayleighMixtureData.intervalCount;
-		double*& weights = rayleighMixtureData.Weights;
+		int* intervalIndices = IntegralImageData<T>::createIntervalIndices(rayleighMixtureData.histogram, intervalCount, rayleighMixtureData.intervals);
 
-		Mat& I2 = integralImageData.I2;
-		Mat& C = integralImageData.C;
+		const double safetyFactor = 1.0 - 1e-6;
+		vector<double> intervalThresholds(intervalCount, 0.0);
+		for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+			const double logRatio = log(rayleighMixtureData.Weights[intervalIndex] * (1.0 - exponentialRelativeError) / probabilityOfFalseAlarm);
+			intervalThresholds[intervalIndex] = (logRatio > 0.0 ? intervalIndices[intervalIndex] * sqrt(logRatio) * safetyFactor : 0.0);
+		}
 
-		const int intervalShiftPerInterval = (image.cols * image.rows);
+		delete[] intervalIndices;
 
-		// detect targets using SAT & Rayleigh mixtures
-		const int minimumClutterArea = (MathUtilities::sqr(2 * windowRadius + 1) - MathUtilities::sqr(2 * guardRadius + 1)) / 2;
+		if (region.width == 0 || region.height == 0) {
+			region = Rect(0, 0, width, height);
+		}
 
-		double* I2w1;
-		double* I2w2;
-		double* I2g1;
-		double* I2g2;
-		int* Cw1;
-		int* Cw2;
-		int* Cg1;
-		int* Cg2;
+		const int blockColumnStart = region.x / blockSize;
+		const int blockColumnEnd = min((region.x + region.width + blockSize - 1) / blockSize, blockColumnCount);
+		const int blockRowEnd = min((region.y + region.height + blockSize - 1) / blockSize, blockRowCount);
 
-		const int x1 = workingRect.x;
-		const int y1 = workingRect.y;
-		const int x2 = x1 + workingRect.width;
-		const int y2 = y1 + workingRect.height;
+		for (int by = region.y / blockSize; by < blockRowEnd; by++) {
+			const int y1 = by * blockSize;
+			const int y2 = min(y1 + blockSize, height) - 1;
 
-		const double minimumTargetValue = 1.0;
+			double* prow = (double*)(prescreenThresholdMap.data + by * prescreenThresholdMap.step);
 
-		int targetCount = 0;
-		int expansionCount = 0;
+			for (int bx = blockColumnStart; bx < blockColumnEnd; bx++) {
+				const int x1 = bx * blockSize;
+				const int x2 = min(x1 + blockSize, width) - 1;
 
-		for (int y = y1; y < y2; y++) {	
-			T* irow = (T*)(image.data + y * image.step);
-			unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+				if (y1 - windowRadius < 0 || y2 + windowRadius >= height || x1 - windowRadius < 0 || x2 + windowRadius >= width) {
+					continue;
+				}
 
-			double* I2row = (double*)(I2.data + y * I2.step);
-			int* Crow = (int*)(C.data + y * C.step);
+				// window is (y-R, y+R] x (x-R, x+R] and guard is (y-g, y+g] x (x-g, x+g] in the SAT corner convention, the common ring is split into four strips
+				unsigned int membership = 0;
+				membership |= orIntervalMembership(integralImageData.intervalMembership, y2 - windowRadius + 1, y1 - guardRadius, x2 - windowRadius + 1, x1 + windowRadius);
+				membership |= orIntervalMembership(integralImageData.intervalMembership, y2 + guardRadius + 1, y1 + windowRadius, x2 - windowRadius + 1, x1 + windowRadius);
+				membership |= orIntervalMembership(integralImageData.intervalMembership, y2 - guardRadius + 1, y1 + guardRadius, x2 - windowRadius + 1, x1 - guardRadius);
+				membership |= orIntervalMembership(integralImageData.intervalMembership, y2 - guardRadius + 1, y1 + guardRadius, x2 + guardRadius + 1, x1 + windowRadius);
+
+				double prescreenThreshold = 0.0;
+				for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+					if ((membership >> intervalIndex) & 1) {
+						prescreenThreshold = max(prescreenThreshold, intervalThresholds[intervalIndex]);
+					}
+				}
 
-			int lastExpansion = 0;
-			for (int x = x1; x < x2; x++) {
-				trow[x] = 0;
+				prow[bx] = prescreenThreshold;
+			}
+		}
 
-				const double pixelValue = irow[x];
-				if (pixelValue >= minimumTargetValue) {
-					const double pixelValueSqr = (pixelValue * pixelValue);
+		return prescreenThresholdMap;
+	}
 
-					for (int expansion=1; expansion<maximumExpansion; expansion++) {
-						if (expansion != lastExpansion) {
-							determineRowPointers(guardRadius, expansion * windowRadius, image.rows, y, I2, C, I2w1, I2w2, I2g1, I2g2, Cw1, Cw2, Cg1, Cg2);
-							lastExpansion = expansion;
-						}
+	// union of the interval memberships of the pixels [y1, y2] x [x1, x2] (0 if the range is empty)
+	static unsigned int orIntervalMembership(Mat& intervalMembership, int y1, int y2, int x1, int x2)
+	{
+		unsigned int membership = 0;
+		for (int y = y1; y <= y2; y++) {
+			if (intervalMembership.type() == CV_8UC1) {
+				const unsigned char* mrow = (unsigned char*)(intervalMembership.data + y * intervalMembership.step);
+				for (int x = x1; x <= x2; x++) {
+					membership |= mrow[x];
+				}
+			}
+			else {
+				const unsigned int* mrow = (unsigned int*)(intervalMembership.data + y * intervalMembership.step);
+				for (int x = x1; x <= x2; x++) {
+					membership |= mrow[x];
+				}
+			}
+		}
+
+		return membership;
+	}
+
+	// detects targets of the image row pixels [x1, x2), satRows[expansion] holds the SAT rows of each expansion (1 to maximumExpansion-1),
+	// prescreenThresholds (optional) holds the pre-screening threshold of each row pixel
+	template<typename TI2, typename TC>
+	void detectRow(const DetectionKernelParameters& kernelParameters, T* irow, unsigned char* trow, int x1, int x2, SummedAreaTableRows<TI2, TC>* satRows, int& targetCount, int& expansionCount,
+		const double* prescreenThresholds = NULL)
+	{
+		const int width = kernelParameters.width;
+		const int intervalCount = kernelParameters.intervalCount;
+		const int pixelStride = kernelParameters.pixelStride;
+		const int intervalStride = kernelParameters.intervalStride;
+		const double* weights = kernelParameters.weights;
+		const int guardRadius = kernelParameters.guardRadius;
+		const int windowRadius = kernelParameters.windowRadius;
+		const int minimumClutterArea = kernelParameters.minimumClutterArea;
+		const double probabilityOfFalseAlarm = kernelParameters.probabilityOfFalseAlarm;
+		const ExponentialTable* exponentialTable = kernelParameters.exponentialTable;
+
+		const double minimumTargetValue = 1.0;
+
+		// vectorized kernel handles as many pixels as it can, the rest is done pixel by pixel
+		const int xStart = (isVectorized ? detectRowVectorized(kernelParameters, irow, trow, x1, x2, satRows, targetCount, expansionCount, prescreenThresholds) : x1);
+
+		for (int x = xStart; x < x2; x++) {
+			trow[x] = 0;
+
+			const double pixelValue = irow[x];
+			if (pixelValue >= minimumTargetValue && (prescreenThresholds == NULL || pixelValue > prescreenThresholds[x])) {
+				const double pixelValueSqr = (pixelValue * pixelValue);
 
-						double probabilitySum = 0.0;
-						double clutterArea = 0.0;
+				for (int expansion=1; expansion<maximumExpansion; expansion++) {
+					const SummedAreaTableRows<TI2, TC>& rows = satRows[expansion];
 
-						int intervalShift = 0;
-						for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
-							const int wx1 = intervalShift + max(x - expansion * windowRadius, 0);
-							const int wx2 = intervalShift + min(x + expansion * windowRadius, image.cols - 1);
-							const int gx1 = intervalShift + max(x - guardRadius, 0);
-							const int gx2 = intervalShift + min(x + guardRadius, image.cols - 1);
+					double probabilitySum = 0.0;
+					double clutterArea = 0.0;
 
-							const double sumC = (Cw1[wx1] + Cw2[wx2] - Cw1[wx2] - Cw2[wx1]) - (Cg1[gx1] + Cg2[gx2] - Cg1[gx2] - Cg2[gx1]);
-							if (sumC > 0) {
-								clutterArea += sumC;
+					const int wx1Shifted = max(x - expansion * windowRadius, 0) * pixelStride;
+					const int wx2Shifted = min(x + expansion * windowRadius, width - 1) * pixelStride;
+					const int gx1Shifted = max(x - guardRadius, 0) * pixelStride;
+					const int gx2Shifted = min(x + guardRadius, width - 1) * pixelStride;
 
-								const double sumI2 = (I2w1[wx1] + I2w2[wx2] - I2w1[wx2] - I2w2[wx1]) - (I2g1[gx1] + I2g2[gx2] - I2g1[gx2] - I2g2[gx1]);
+					int intervalShift = 0;
+					for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+						const int wx1 = intervalShift + wx1Shifted;
+						const int wx2 = intervalShift + wx2Shifted;
+						const int gx1 = intervalShift + gx1Shifted;
+						const int gx2 = intervalShift + gx2Shifted;
 
-								const double sigmaSqr = (0.5 * sumI2 / sumC);
-								const double RayleighProbability = exp(-0.5 * pixelValueSqr / sigmaSqr);
-								probabilitySum += weights[intervalIndex] * RayleighProbability;
+						const double sumC = (TC)((rows.Cw1[wx1] + rows.Cw2[wx2] - rows.Cw1[wx2] - rows.Cw2[wx1]) - (rows.Cg1[gx1] + rows.Cg2[gx2] - rows.Cg1[gx2] - rows.Cg2[gx1]));
+						if (sumC > 0) {
+							clutterArea += sumC;
 
-								// if not target decision is certain then do early-exit 
-								if (clutterArea >= minimumClutterArea && probabilitySum > probabilityOfFalseAlarm) {
-									break;
-								}
+							const double sumI2 = (TI2)((rows.I2w1[wx1] + rows.I2w2[wx2] - rows.I2w1[wx2] - rows.I2w2[wx1]) - (rows.I2g1[gx1] + rows.I2g2[gx2] - rows.I2g1[gx2] - rows.I2g2[gx1]));
+
+							const double sigmaSqr = (0.5 * sumI2 / sumC);
+							const double RayleighProbability = (exponentialTable != NULL ? exponentialTable->negativeExp(0.5 * pixelValueSqr / sigmaSqr) : exp(-0.5 * pixelValueSqr / sigmaSqr));
+							probabilitySum += weights[intervalIndex] * RayleighProbability;
+
+							// if not target decision is certain then do early-exit 
+							if (clutterArea >= minimumClutterArea && probabilitySum > probabilityOfFalseAlarm) {
+								break;
 							}
+						}
+
+						intervalShift += intervalStride;
+					}
+
+					// target decision rule
+					if (clutterArea >= minimumClutterArea) {
+						trow[x] = (probabilitySum < probabilityOfFalseAlarm ? UCHAR_MAX : 0);
 
-							intervalShift += intervalShiftPerInterval;
+						if (trow[x] > 0) {
+							targetCount++;
 						}
+						break;
+					}
 
-						// target decision rule
-						if (clutterArea >= minimumClutterArea) {
-							trow[x] = (probabilitySum < probabilityOfFalseAlarm ? UCHAR_MAX : 0);
+					expansionCount++;
+				}
+			}
+		}
+	}
 
-							if (trow[x] > 0) {
-								targetCount++;
-							}
-							break;
+	// probabilitySum of the first expansion with enough clutter for the row pixels [x1, x2), evaluated over all intervals (no early-exit),
+	// pixels that are never decided (no data or too little clutter) get 1, so a pixel is a target at any Pfa iff its probability is below Pfa
+	template<typename TI2, typename TC>
+	void calculateProbabilityRow(const DetectionKernelParameters& kernelParameters, T* irow, float* prow, int x1, int x2, SummedAreaTableRows<TI2, TC>* satRows)
+	{
+		const int width = kernelParameters.width;
+		const int intervalCount = kernelParameters.intervalCount;
+		const int pixelStride = kernelParameters.pixelStride;
+		const int intervalStride = kernelParameters.intervalStride;
+		const double* weights = kernelParameters.weights;
+		const int guardRadius = kernelParameters.guardRadius;
+		const int windowRadius = kernelParameters.windowRadius;
+		const int minimumClutterArea = kernelParameters.minimumClutterArea;
+		const ExponentialTable* exponentialTable = kernelParameters.exponentialTable;
+
+		const double minimumTargetValue = 1.0;
+
+		for (int x = x1; x < x2; x++) {
+			prow[x] = 1.0f;
+
+			const double pixelValue = irow[x];
+			if (pixelValue >= minimumTargetValue) {
+				const double pixelValueSqr = (pixelValue * pixelValue);
+
+				for (int expansion = 1; expansion<maximumExpansion; expansion++) {
+					const SummedAreaTableRows<TI2, TC>& rows = satRows[expansion];
+
+					double probabilitySum = 0.0;
+					double clutterArea = 0.0;
+
+					const int wx1Shifted = max(x - expansion * windowRadius, 0) * pixelStride;
+					const int wx2Shifted = min(x + expansion * windowRadius, width - 1) * pixelStride;
+					const int gx1Shifted = max(x - guardRadius, 0) * pixelStride;
+					const int gx2Shifted = min(x + guardRadius, width - 1) * pixelStride;
+
+					int intervalShift = 0;
+					for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+						const int wx1 = intervalShift + wx1Shifted;
+						const int wx2 = intervalShift + wx2Shifted;
+						const int gx1 = intervalShift + gx1Shifted;
+						const int gx2 = intervalShift + gx2Shifted;
+
+						const double sumC = (TC)((rows.Cw1[wx1] + rows.Cw2[wx2] - rows.Cw1[wx2] - rows.Cw2[wx1]) - (rows.Cg1[gx1] + rows.Cg2[gx2] - rows.Cg1[gx2] - rows.Cg2[gx1]));
+						if (sumC > 0) {
+							clutterArea += sumC;
+
+							const double sumI2 = (TI2)((rows.I2w1[wx1] + rows.I2w2[wx2] - rows.I2w1[wx2] - rows.I2w2[wx1]) - (rows.I2g1[gx1] + rows.I2g2[gx2] - rows.I2g1[gx2] - rows.I2g2[gx1]));
+
+							const double sigmaSqr = (0.5 * sumI2 / sumC);
+							const double RayleighProbability = (exponentialTable != NULL ? exponentialTable->negativeExp(0.5 * pixelValueSqr / sigmaSqr) : exp(-0.5 * pixelValueSqr / sigmaSqr));
+							probabilitySum += weights[intervalIndex] * RayleighProbability;
 						}
 
-						expansionCount++;
+						intervalShift += intervalStride;
+					}
+
+					if (clutterArea >= minimumClutterArea) {
+						prow[x] = (float)probabilitySum;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// SAT rows of the boxes centered at row y, rows are clamped into [0, height-1] and given by satRow(index)
+	template<typename TI2, typename TC, typename RowAccessor>
+	static inline void determineRowPointers(int guardRadius, int windowRadius, int height, int y, RowAccessor satRow, SummedAreaTableRows<TI2, TC>& rows)
+	{
+		const int wy1 = max(y - windowRadius, 0);
+		const int wy2 = min(y + windowRadius, height - 1);
+		const int gy1 = max(y - guardRadius, 0);
+		const int gy2 = min(y + guardRadius, height - 1);
+
+		satRow(wy1, rows.I2w1, rows.Cw1);
+		satRow(wy2, rows.I2w2, rows.Cw2);
+		satRow(gy1, rows.I2g1, rows.Cg1);
+		satRow(gy2, rows.I2g2, rows.Cg2);
+	}
+
+private:
+	int maximumExpansion;
+	bool isVectorized;
+	const ExponentialTable* exponentialTable;
+	bool isPrescreened;
+	int threadCount;
+
+	// no vectorized kernel for this SAT storage
+	template<typename TI2, typename TC>
+	int detectRowVectorized(const DetectionKernelParameters& kernelParameters, T* irow, unsigned char* trow, int x1, int x2, SummedAreaTableRows<TI2, TC>* satRows, int& targetCount, int& expansionCount,
+		const double* prescreenThresholds)
+	{
+		return x1;
+	}
+
+	// the AVX2 kernel runs on CPUs that support it, the pixels are handed over in blocks converted to double
+	int detectRowVectorized(const DetectionKernelParameters& kernelParameters, T* irow, unsigned char* trow, int x1, int x2, SummedAreaTableRows<double, int>* satRows, int& targetCount, int& expansionCount,
+		const double* prescreenThresholds)
+	{
+		if (!MathUtilities::isAVX2Supported()) {
+			return x1;
+		}
+
+		const int blockSize = 256;
+		double pixelValues[blockSize];
+
+		int x = x1;
+		while (x < x2) {
+			const int blockEnd = min(x + blockSize, x2);
+			for (int i = x; i < blockEnd; i++) {
+				pixelValues[i - x] = irow[i];
+			}
+
+			const int processedEnd = detectRowAVX2(kernelParameters, maximumExpansion, pixelValues, trow, x, blockEnd, satRows, targetCount, expansionCount, prescreenThresholds);
+			if (processedEnd < blockEnd) {
+				return processedEnd;
+			}
+
+			x = blockEnd;
+		}
+
+		return x;
+	}
+
+	// TI2 and TC are the element types of the SATs, box sums are evaluated in the storage type so that compact (wrapping) storage yields exact sums
+	template<typename TI2, typename TC>
+	TargetDetectionInformation detectTargets(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, double probabilityOfFalseAlarm, Mat& targetMap, Rect workingRect)
+	{
+		Mat& image = rayleighMixtureData.image;
+
+		Mat& I2 = integralImageData.I2;
+		Mat& C = integralImageData.C;
+
+		// SAT layout (see IntegralImageData), interleaved layout keeps all intervals of a corner in one cache line
+		DetectionKernelParameters kernelParameters = createKernelParameters(rayleighMixtureData, image.cols, integralImageData.pixelStride, integralImageData.intervalStride, guardRadius, windowRadius, probabilityOfFalseAlarm);
+		kernelParameters.exponentialTable = exponentialTable;
+
+		// detect targets using SAT & Rayleigh mixtures
+		const int x1 = workingRect.x;
+		const int y1 = workingRect.y;
+		const int x2 = x1 + workingRect.width;
+		const int y2 = y1 + workingRect.height;
+
+		MatRowAccessor<TI2, TC> satRow(I2, C);
+
+		// thresholds are kept per block and expanded into a row of per-pixel thresholds, the ring part shared by a block vanishes for blocks wider than R-g
+		const int prescreenBlockSize = max(1, min(4, windowRadius - guardRadius));
+		Mat prescreenThresholdMap;
+		if (isPrescreened) {
+			prescreenThresholdMap = createPrescreenThresholdMap(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm,
+				(exponentialTable != NULL ? exponentialTable->getMaximumRelativeError() : 0.0), prescreenBlockSize, workingRect);
+		}
+
+		int targetCount = 0;
+		int expansionCount = 0;
+
+		// rows are independent, every thread keeps its own row pointers and thresholds
+		int y;
+		#pragma omp parallel num_threads(threadCount) if (threadCount > 1) reduction(+: targetCount, expansionCount)
+		{
+			vector<SummedAreaTableRows<TI2, TC>> satRows(maximumExpansion);
+			vector<double> prescreenThresholds(isPrescreened ? image.cols : 0);
+
+			#pragma omp for schedule(dynamic, 16)
+			for (y = y1; y < y2; y++) {
+				T* irow = (T*)(image.data + y * image.step);
+				unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+
+				for (int expansion = 1; expansion < maximumExpansion; expansion++) {
+					determineRowPointers(guardRadius, expansion * windowRadius, image.rows, y, satRow, satRows[expansion]);
+				}
+
+				if (isPrescreened) {
+					const double* prow = (double*)(prescreenThresholdMap.data + (y / prescreenBlockSize) * prescreenThresholdMap.step);
+					for (int x = x1; x < x2; x++) {
+						prescreenThresholds[x] = prow[x / prescreenBlockSize];
 					}
 				}
+
+				detectRow<TI2, TC>(kernelParameters, irow, trow, x1, x2, &satRows[0], targetCount, expansionCount, (isPrescreened ? &prescreenThresholds[0] : NULL));
 			}
 		}
 
@@ -144,25 +531,142 @@ public:
 		return TargetDetectionInformation(targetRatio, expansionRatio);
 	}
 
-private:
-	int maximumExpansion;
+	template<typename TI2, typename TC>
+	void calculateProbabilities(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, Mat& probabilityMap, Rect workingRect)
+	{
+		Mat& image = rayleighMixtureData.image;
+
+		// the probability of false alarm is not used by the probability kernel
+		DetectionKernelParameters kernelParameters = createKernelParameters(rayleighMixtureData, image.cols, integralImageData.pixelStride, integralImageData.intervalStride, guardRadius, windowRadius, 1.0);
+		kernelParameters.exponentialTable = exponentialTable;
+
+		const int x1 = workingRect.x;
+		const int y1 = workingRect.y;
+		const int x2 = x1 + workingRect.width;
+		const int y2 = y1 + workingRect.height;
 
-	inline void determineRowPointers(int guardRadius, int windowRadius, int height, int y, Mat& I2, Mat& C,
-		double*& I2w1, double*& I2w2, double*& I2g1, double*& I2g2, int*& Cw1, int*& Cw2, int*& Cg1, int*& Cg2)
+		MatRowAccessor<TI2, TC> satRow(integralImageData.I2, integralImageData.C);
+
+		int y;
+		#pragma omp parallel num_threads(threadCount) if (threadCount > 1)
+		{
+			vector<SummedAreaTableRows<TI2, TC>> satRows(maximumExpansion);
+
+			#pragma omp for schedule(dynamic, 16)
+			for (y = y1; y < y2; y++) {
+				T* irow = (T*)(image.data + y * image.step);
+				float* prow = (float*)(probabilityMap.data + y * probabilityMap.step);
+
+				for (int expansion = 1; expansion < maximumExpansion; expansion++) {
+					determineRowPointers(guardRadius, expansion * windowRadius, image.rows, y, satRow, satRows[expansion]);
+				}
+
+				calculateProbabilityRow<TI2, TC>(kernelParameters, irow, prow, x1, x2, &satRows[0]);
+			}
+		}
+	}
+
+	// probabilities are evaluated only for the target pixels, a target never takes the early-exit so its probability is the sum the decision was made with
+	template<typename TI2, typename TC>
+	void collectDetections(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, Mat& targetMap, Rect workingRect,
+		vector<TargetDetection>& detections)
 	{
-		const int wy1 = max(y - windowRadius, 0);
-		const int wy2 = min(y + windowRadius, height - 1);
-		const int gy1 = max(y - guardRadius, 0);
-		const int gy2 = min(y + guardRadius, height - 1);
+		Mat& image = rayleighMixtureData.image;
+
+		DetectionKernelParameters kernelParameters = createKernelParameters(rayleighMixtureData, image.cols, integralImageData.pixelStride, integralImageData.intervalStride, guardRadius, windowRadius, 1.0);
+		kernelParameters.exponentialTable = exponentialTable;
+
+		const int x1 = workingRect.x;
+		const int y1 = workingRect.y;
+		const int x2 = x1 + workingRect.width;
+		const int y2 = y1 + workingRect.height;
+
+		vector<SummedAreaTableRows<TI2, TC>> satRows(maximumExpansion);
+		MatRowAccessor<TI2, TC> satRow(integralImageData.I2, integralImageData.C);
+
+		vector<float> probabilities(image.cols);
+
+		for (int y = y1; y < y2; y++) {
+			T* irow = (T*)(image.data + y * image.step);
+			const unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+
+			bool areRowPointersSet = false;
+			for (int x = x1; x < x2; x++) {
+				if (trow[x] == 0) {
+					continue;
+				}
 
-		I2w1 = (double*)(I2.data + wy1 * I2.step);
-		I2w2 = (double*)(I2.data + wy2 * I2.step);
-		I2g1 = (double*)(I2.data + gy1 * I2.step);
-		I2g2 = (double*)(I2.data + gy2 * I2.step);
+				if (!areRowPointersSet) {
+					for (int expansion = 1; expansion < maximumExpansion; expansion++) {
+						determineRowPointers(guardRadius, expansion * windowRadius, image.rows, y, satRow, satRows[expansion]);
+					}
+					areRowPointersSet = true;
+				}
 
-		Cw1 = (int*)(C.data + wy1 * C.step);
-		Cw2 = (int*)(C.data + wy2 * C.step);
-		Cg1 = (int*)(C.data + gy1 * C.step);
-		Cg2 = (int*)(C.data + gy2 * C.step);
+				calculateProbabilityRow<TI2, TC>(kernelParameters, irow, &probabilities[0], x, x + 1, &satRows[0]);
+				detections.push_back(TargetDetection(x, y, irow[x], probabilities[x]));
+			}
+		}
 	}
+
+	template<typename TI2, typename TC>
+	double calculateClutterSigma(RayleighMixtureData& rayleighMixtureData, IntegralImageData<T>& integralImageData, int guardRadius, int windowRadius, int x, int y)
+	{
+		Mat& image = rayleighMixtureData.image;
+
+		const int width = image.cols;
+		const int pixelStride = integralImageData.pixelStride;
+		const int intervalStride = integralImageData.intervalStride;
+		const int minimumClutterArea = (MathUtilities::sqr(2 * windowRadius + 1) - MathUtilities::sqr(2 * guardRadius + 1)) / 2;
+
+		MatRowAccessor<TI2, TC> satRow(integralImageData.I2, integralImageData.C);
+
+		for (int expansion = 1; expansion < maximumExpansion; expansion++) {
+			SummedAreaTableRows<TI2, TC> rows;
+			determineRowPointers(guardRadius, expansion * windowRadius, image.rows, y, satRow, rows);
+
+			const int wx1Shifted = max(x - expansion * windowRadius, 0) * pixelStride;
+			const int wx2Shifted = min(x + expansion * windowRadius, width - 1) * pixelStride;
+			const int gx1Shifted = max(x - guardRadius, 0) * pixelStride;
+			const int gx2Shifted = min(x + guardRadius, width - 1) * pixelStride;
+
+			double clutterArea = 0.0;
+			double clutterI2 = 0.0;
+
+			int intervalShift = 0;
+			for (int intervalIndex = 0; intervalIndex < rayleighMixtureData.intervalCount; intervalIndex++) {
+				const int wx1 = intervalShift + wx1Shifted;
+				const int wx2 = intervalShift + wx2Shifted;
+				const int gx1 = intervalShift + gx1Shifted;
+				const int gx2 = intervalShift + gx2Shifted;
+
+				clutterArea += (TC)((rows.Cw1[wx1] + rows.Cw2[wx2] - rows.Cw1[wx2] - rows.Cw2[wx1]) - (rows.Cg1[gx1] + rows.Cg2[gx2] - rows.Cg1[gx2] - rows.Cg2[gx1]));
+				clutterI2 += (TI2)((rows.I2w1[wx1] + rows.I2w2[wx2] - rows.I2w1[wx2] - rows.I2w2[wx1]) - (rows.I2g1[gx1] + rows.I2g2[gx2] - rows.I2g1[gx2] - rows.I2g2[gx1]));
+
+				intervalShift += intervalStride;
+			}
+
+			if (clutterArea >= minimumClutterArea) {
+				return sqrt(0.5 * clutterI2 / clutterArea);
+			}
+		}
+
+		return 0.0;
+	}
+
+	template<typename TI2, typename TC>
+	struct MatRowAccessor {
+		Mat& I2;
+		Mat& C;
+
+		MatRowAccessor(Mat& I2, Mat& C) : I2(I2), C(C)
+		{
+		}
+
+		inline void operator()(int y, TI2*& I2row, TC*& Crow) const
+		{
+			I2row = (TI2*)(I2.data + y * I2.step);
+			Crow = (TC*)(C.data + y * C.step);
+		}
+	};
 };
@@ -41,107 +41,161 @@ public:
 		}
 	}
 
-	static Mat createHistogram(Mat& image, int startValue = 0)
+	// threadCount > 1 splits the rows over threads (nested region if called from a parallel region), the histogram is the same
+	static Mat createHistogram(Mat& image, int startValue = 0, int threadCount = 1)
 	{
 		Mat histogram;
 
 		switch (image.type())
 		{
-		case CV_8U:  createHistogram<unsigned char>(image, histogram, startValue);		break;
-		case CV_8S:  createHistogram<char>(image, histogram, startValue);				break;
-		case CV_16U: createHistogram<unsigned short>(image, histogram, startValue);		break;
-		case CV_16S: createHistogram<short>(image, histogram, startValue);				break;
-		case CV_32S: createHistogram<int>(image, histogram, startValue);				break;
-		case CV_32F: createHistogram<float>(image, histogram, startValue);				break;
-		case CV_64F: createHistogram<double>(image, histogram, startValue);				break;
+		case CV_8U:  createHistogram<unsigned char>(image, histogram, startValue, threadCount);		break;
+		case CV_8S:  createHistogram<char>(image, histogram, startValue, threadCount);				break;
+		case CV_16U: createHistogram<unsigned short>(image, histogram, startValue, threadCount);	break;
+		case CV_16S: createHistogram<short>(image, histogram, startValue, threadCount);				break;
+		case CV_32S: createHistogram<int>(image, histogram, startValue, threadCount);				break;
+		case CV_32F: createHistogram<float>(image, histogram, startValue, threadCount);				break;
+		case CV_64F: createHistogram<double>(image, histogram, startValue, threadCount);			break;
 		}
 
 		return histogram;
 	}
 
-	static Mat createHistogram(Mat& image, Mat& censorMap)
+	static Mat createHistogram(Mat& image, Mat& censorMap, int threadCount = 1)
 	{
 		Mat histogram;
 
 		switch (image.type())
 		{
-		case CV_8U:  createHistogram<unsigned char>(image, censorMap, histogram);		break;
-		case CV_8S:  createHistogram<char>(image, censorMap, histogram);				break;
-		case CV_16U: createHistogram<unsigned short>(image, censorMap, histogram);		break;
-		case CV_16S: createHistogram<short>(image, censorMap, histogram);				break;
-		case CV_32S: createHistogram<int>(image, censorMap, histogram);					break;
-		case CV_32F: createHistogram<float>(image, censorMap, histogram);				break;
-		case CV_64F: createHistogram<double>(image, censorMap, histogram);				break;
+		case CV_8U:  createHistogram<unsigned char>(image, censorMap, histogram, 1, threadCount);		break;
+		case CV_8S:  createHistogram<char>(image, censorMap, histogram, 1, threadCount);				break;
+		case CV_16U: createHistogram<unsigned short>(image, censorMap, histogram, 1, threadCount);		break;
+		case CV_16S: createHistogram<short>(image, censorMap, histogram, 1, threadCount);				break;
+		case CV_32S: createHistogram<int>(image, censorMap, histogram, 1, threadCount);					break;
+		case CV_32F: createHistogram<float>(image, censorMap, histogram, 1, threadCount);				break;
+		case CV_64F: createHistogram<double>(image, censorMap, histogram, 1, threadCount);				break;
 		}
 
 		return histogram;
 	}
 
+	// every thread takes a block of rows and counts into its own histogram row, the rows are summed at the end
 	template<typename T>
-	static void createHistogram(Mat& image, Mat& histogram, int startValue=1)
+	static void createHistogram(Mat& image, Mat& histogram, int startValue = 1, int threadCount = 1)
 	{
-		int maximumIntensity = 0;
-		for (int y = 0; y < image.rows; y++) {
-			T* irow = (T*)(image.data + y * image.step);
+		threadCount = max(min(threadCount, image.rows), 1);
+
+		int t;
+		vector<int> maximumIntensities(threadCount, 0);
+		#pragma omp parallel for num_threads(threadCount) if (threadCount > 1)
+		for (t = 0; t < threadCount; t++) {
+			int maximumIntensity = 0;
+			for (int y = t * image.rows / threadCount; y < (t + 1) * image.rows / threadCount; y++) {
+				T* irow = (T*)(image.data + y * image.step);
 
-			for (int x = 0; x < image.cols; x++) {
-				maximumIntensity = max(maximumIntensity, (int)irow[x]);
+				for (int x = 0; x < image.cols; x++) {
+					maximumIntensity = max(maximumIntensity, (int)irow[x]);
+				}
 			}
+			maximumIntensities[t] = maximumIntensity;
 		}
 
+		const int maximumIntensity = *max_element(maximumIntensities.begin(), maximumIntensities.end());
 		const int histogramSize = (maximumIntensity + 1);
 		histogram = Mat(1, histogramSize, CV_32SC1, Scalar(0));
-		int* histogramData = (int*)histogram.data;
 
 		if (maximumIntensity > 0) {
-			for (int y = 0; y < image.rows; y++) {
-				T* irow = (T*)(image.data + y * image.step);
+			Mat threadHistograms = (threadCount > 1 ? Mat(threadCount, histogramSize, CV_32SC1, Scalar(0)) : histogram);
 
-				for (int x = 0; x < image.cols; x++) {
-					const int pixelValue = (int)irow[x];
+			#pragma omp parallel for num_threads(threadCount) if (threadCount > 1)
+			for (t = 0; t < threadCount; t++) {
+				int* histogramData = (int*)(threadHistograms.data + t * threadHistograms.step);
+
+				for (int y = t * image.rows / threadCount; y < (t + 1) * image.rows / threadCount; y++) {
+					T* irow = (T*)(image.data + y * image.step);
+
+					for (int x = 0; x < image.cols; x++) {
+						const int pixelValue = (int)irow[x];
 
-					if (pixelValue >= startValue) {
-						histogramData[pixelValue]++;
+						if (pixelValue >= startValue) {
+							histogramData[pixelValue]++;
+						}
 					}
 				}
 			}
+
+			if (threadCount > 1) {
+				sumHistogramRows(threadHistograms, histogram);
+			}
 		}
 	}
 
 	template<typename T>
-	static void createHistogram(Mat& image, Mat& censorMap, Mat& histogram, int startValue = 1)
+	static void createHistogram(Mat& image, Mat& censorMap, Mat& histogram, int startValue = 1, int threadCount = 1)
 	{
-		int maximumIntensity = 0;
-		for (int y = 0; y < image.rows; y++) {
-			T* irow = (T*)(image.data + y * image.step);
-			unsigned char* crow = (unsigned char*)(censorMap.data + y * censorMap.step);
+		threadCount = max(min(threadCount, image.rows), 1);
+
+		int t;
+		vector<int> maximumIntensities(threadCount, 0);
+		#pragma omp parallel for num_threads(threadCount) if (threadCount > 1)
+		for (t = 0; t < threadCount; t++) {
+			int maximumIntensity = 0;
+			for (int y = t * image.rows / threadCount; y < (t + 1) * image.rows / threadCount; y++) {
+				T* irow = (T*)(image.data + y * image.step);
+				unsigned char* crow = (unsigned char*)(censorMap.data + y * censorMap.step);
 
-			for (int x = 0; x < image.cols; x++) {
-				if (crow[x] == 0) {
-					maximumIntensity = max(maximumIntensity, (int)irow[x]);
+				for (int x = 0; x < image.cols; x++) {
+					if (crow[x] == 0) {
+						maximumIntensity = max(maximumIntensity, (int)irow[x]);
+					}
 				}
 			}
+			maximumIntensities[t] = maximumIntensity;
 		}
 
+		const int maximumIntensity = *max_element(maximumIntensities.begin(), maximumIntensities.end());
 		const int histogramSize = (maximumIntensity + 1);
 		histogram = Mat(1, histogramSize, CV_32SC1, Scalar(0));
-		int* histogramData = (int*)histogram.data;
 
 		if (maximumIntensity > 0) {
-			for (int y = 0; y < image.rows; y++) {
-				T* irow = (T*)(image.data + y * image.step);
-				unsigned char* crow = (unsigned char*)(censorMap.data + y * censorMap.step);
+			Mat threadHistograms = (threadCount > 1 ? Mat(threadCount, histogramSize, CV_32SC1, Scalar(0)) : histogram);
 
-				for (int x = 0; x < image.cols; x++) {
-					if (crow[x] == 0) {
-						const int pixelValue = (int)irow[x];
+			#pragma omp parallel for num_threads(threadCount) if (threadCount > 1)
+			for (t = 0; t < threadCount; t++) {
+				int* histogramData = (int*)(threadHistograms.data + t * threadHistograms.step);
 
-						if (pixelValue >= startValue) {
-							histogramData[pixelValue]++;
+				for (int y = t * image.rows / threadCount; y < (t + 1) * image.rows / threadCount; y++) {
+					T* irow = (T*)(image.data + y * image.step);
+					unsigned char* crow = (unsigned char*)(censorMap.data + y * censorMap.step);
+
+					for (int x = 0; x < image.cols; x++) {
+						if (crow[x] == 0) {
+							const int pixelValue = (int)irow[x];
+
+							if (pixelValue >= startValue) {
+								histogramData[pixelValue]++;
+							}
 						}
 					}
 				}
 			}
+
+			if (threadCount > 1) {
+				sumHistogramRows(threadHistograms, histogram);
+			}
+		}
+	}
+
+	// histogram (1 x cols) = sum of the rows of rowHistograms (CV_32S)
+	static void sumHistogramRows(Mat& rowHistograms, Mat& histogram)
+	{
+		int* histogramData = (int*)histogram.data;
+
+		for (int r = 0; r < rowHistograms.rows; r++) {
+			int* rowData = (int*)(rowHistograms.data + r * rowHistograms.step);
+
+			for (int i = 0; i < histogram.cols; i++) {
+				histogramData[i] += rowData[i];
+			}
 		}
 	}
 
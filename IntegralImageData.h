@@ -8,12 +8,44 @@ using namespace std;
 using namespace cv;
 
 
+// LayoutPlanar       --> each interval is an image.rows-tall slab, i.e. (interval, y, x)
+// LayoutInterleaved  --> all intervals of a pixel are contiguous, i.e. (y, x, interval)
+enum IntegralImageLayout { LayoutPlanar, LayoutInterleaved };						// default : LayoutInterleaved
+
+// StorageDouble      --> I2 : CV_64F, C : CV_32S
+// StorageCompact     --> I2 : 32-bit unsigned, C : 16-bit or 32-bit unsigned, all wrapping modulo 2^bits
+//                        (a box sum is exact as long as the true box sum fits into the storage type)
+enum IntegralImageStorage { StorageDouble, StorageCompact };						// default : StorageDouble
+
+// BuilderRecurrence  --> single pass S(x,y) = v + S(x-1,y) + S(x,y-1) - S(x-1,y-1), serial
+// BuilderRowColumn   --> row prefix sums followed by column accumulation, both passes are split over threads
+// BuilderDeferred    --> SATs are only allocated, the caller runs buildRowPrefixSums for every row and then buildColumnStrip for every strip
+//                        (e.g. as tasks of a scheduler), threadCount sets the number of strips
+enum IntegralImageBuilder { BuilderRecurrence, BuilderRowColumn, BuilderDeferred };	// default : BuilderRowColumn
+
 template<typename T>
 class IntegralImageData {
 public:
 	Mat I2, C;
 
-	IntegralImageData(RayleighMixtureData& rayleighMixtureData)
+	IntegralImageLayout layout;
+	IntegralImageStorage storage;
+	int intervalCount;
+
+	// element offset of (x, interval) within a SAT row is x * pixelStride + interval * intervalStride
+	int pixelStride;
+	int intervalStride;
+
+	// bit k of intervalMembershipTable[v] is set if pixel value v belongs to interval k (1 x maximum pixel value + 1, CV_32S)
+	Mat intervalMembershipTable;
+
+	// per-pixel interval membership bitmask of the tile (CV_8U for up to 8 intervals, CV_32S otherwise), censored pixels belong to no interval
+	Mat intervalMembership;
+
+	// maximumWindowRadius is the largest box radius queried from the SATs, compact storage is used only if it can represent every such box sum exactly,
+	// the SATs and the membership map are allocated in the arena if it is given (see TileArena)
+	IntegralImageData(RayleighMixtureData& rayleighMixtureData, IntegralImageLayout layout = LayoutInterleaved, IntegralImageStorage storage = StorageDouble, int maximumWindowRadius = 0,
+		int threadCount = 1, IntegralImageBuilder builder = BuilderRowColumn, TileArena* arena = NULL)
 	{
 		Mat& image = rayleighMixtureData.image;
 		Mat& censorMap = rayleighMixtureData.censorMap;
@@ -21,15 +53,86 @@ public:
 		double* intervals = rayleighMixtureData.intervals;
 
 		int* intervalIndices = createIntervalIndices(rayleighMixtureData.histogram, intervalCount, intervals);
+		intervalMembershipTable = createIntervalMembershipTable(intervalCount, intervalIndices);
+
+		this->layout = layout;
+		this->intervalCount = intervalCount;
+		this->threadCount = max(threadCount, 1);
+		this->builder = builder;
+		this->arena = arena;
+		this->rowLength = 0;
+		this->columnStripCount = 0;
+		this->columnStripWidth = 0;
+		this->builtColumnStripCount = 0;
+
+		const double maximumBoxArea = MathUtilities::sqr(2.0 * maximumWindowRadius + 1.0);
+		const double maximumPixelValue = intervalIndices[intervalCount + 1];
+		const bool isCompactStorageExact = (MathUtilities::sqr(maximumPixelValue) * maximumBoxArea <= UINT_MAX);
 
-		createIntegralImages<T>(image, censorMap, intervalCount, intervalIndices);
+		this->storage = (storage == StorageCompact && maximumWindowRadius > 0 && isCompactStorageExact ? StorageCompact : StorageDouble);
+
+		if (this->storage == StorageCompact) {
+			if (maximumBoxArea <= USHRT_MAX)
+				createIntegralImages<unsigned int, unsigned short>(image, censorMap, intervalCount, intervalIndices, CV_32SC1, CV_16UC1);
+			else
+				createIntegralImages<unsigned int, unsigned int>(image, censorMap, intervalCount, intervalIndices, CV_32SC1, CV_32SC1);
+		}
+		else {
+			createIntegralImages<double, int>(image, censorMap, intervalCount, intervalIndices, CV_64FC1, CV_32SC1);
+		}
 
 		delete[] intervalIndices;
 	}
 
-private:
+	// row pass of BuilderDeferred for the rows [y1, y2), rows are independent
+	void buildRowPrefixSums(int y1, int y2)
+	{
+		for (int y = y1; y < y2; y++) {
+			if (storage == StorageCompact) {
+				if (C.type() == CV_16UC1)
+					createRowPrefixSums<unsigned int, unsigned short>(sourceImage, sourceCensorMap, intervalCount, y);
+				else
+					createRowPrefixSums<unsigned int, unsigned int>(sourceImage, sourceCensorMap, intervalCount, y);
+			}
+			else {
+				createRowPrefixSums<double, int>(sourceImage, sourceCensorMap, intervalCount, y);
+			}
+		}
+	}
 
-	int* createIntervalIndices(Mat& histogram, const int intervalCount, double* intervals)
+	int getColumnStripCount() const
+	{
+		return columnStripCount;
+	}
+
+	// column pass of BuilderDeferred for one strip, strips are independent but every row must have been built before
+	void buildColumnStrip(int strip)
+	{
+		const int x1 = strip * columnStripWidth;
+		const int x2 = min(x1 + columnStripWidth, rowLength);
+
+		if (storage == StorageCompact) {
+			if (C.type() == CV_16UC1)
+				accumulateColumns<unsigned int, unsigned short>(sourceImage.rows, intervalCount, x1, x2);
+			else
+				accumulateColumns<unsigned int, unsigned int>(sourceImage.rows, intervalCount, x1, x2);
+		}
+		else {
+			accumulateColumns<double, int>(sourceImage.rows, intervalCount, x1, x2);
+		}
+
+		// the source is not needed once the last strip is built
+		#pragma omp critical(IntegralImageDataDeferred)
+		{
+			if (++builtColumnStripCount == columnStripCount) {
+				sourceImage = Mat();
+				sourceCensorMap = Mat();
+			}
+		}
+	}
+
+	// histogram indices of the interval bounds, interval k (1 to intervalCount) covers [intervalIndices[k-1], intervalIndices[k+1]], caller deletes the array
+	static int* createIntervalIndices(Mat& histogram, const int intervalCount, double* intervals)
 	{
 		int* intervalIndices = new int[intervalCount + 2];
 		intervalIndices[0] = 1;
@@ -40,28 +143,118 @@ private:
 		return intervalIndices;
 	}
 
-	template<typename T>
-	void createIntegralImages(Mat& image, Mat& censorMap, int intervalCount, int* intervalIndices)
+	static Mat createIntervalMembershipTable(const int intervalCount, int* intervalIndices)
 	{
-		I2 = Mat(image.rows * intervalCount, image.cols, CV_64FC1);
-		C = Mat(image.rows * intervalCount, image.cols, CV_32SC1);
+		const int tableSize = intervalIndices[intervalCount + 1] + 1;
 
-		const int intervalShiftPerInterval = (image.cols * image.rows);
+		Mat membershipTable(1, tableSize, CV_32SC1, Scalar(0));
+		unsigned int* membershipTableData = (unsigned int*)membershipTable.data;
+
+		for (int intervalIndex = 1; intervalIndex <= intervalCount; intervalIndex++) {
+			const int intervalStart = intervalIndices[intervalIndex - 1];
+			const int intervalEnd = min(intervalIndices[intervalIndex + 1], tableSize - 1);
+
+			for (int v = max(intervalStart, 0); v <= intervalEnd; v++) {
+				membershipTableData[v] |= (1u << (intervalIndex - 1));
+			}
+		}
+
+		return membershipTable;
+	}
 
+private:
+	int threadCount;
+	IntegralImageBuilder builder;
+	TileArena* arena;
+
+	// column strips of the row-column builders
+	int rowLength;
+	int columnStripCount;
+	int columnStripWidth;
+
+	// BuilderDeferred keeps the source until the SATs are built
+	Mat sourceImage;
+	Mat sourceCensorMap;
+	int builtColumnStripCount;
+
+	// TI2 and TC are the element types of I2 and C (unsigned types are accumulated modulo 2^bits)
+	template<typename TI2, typename TC>
+	void createIntegralImages(Mat& image, Mat& censorMap, int intervalCount, int* intervalIndices, int I2type, int Ctype)
+	{
+		allocateIntegralImages(image, intervalCount, I2type, Ctype);
+
+		intervalMembership = TileArena::allocate(arena, image.rows, image.cols, (intervalCount <= 8 ? CV_8UC1 : CV_32SC1));
+
+		if (builder == BuilderRecurrence) {
+			createIntegralImagesByRecurrence<TI2, TC>(image, censorMap, intervalCount, intervalIndices);
+			return;
+		}
+
+		// pass 2 works on contiguous column strips
+		rowLength = (layout == LayoutPlanar ? image.cols : image.cols * intervalCount);
+		const int stripAlignment = 16;
+		columnStripCount = min(4 * threadCount, (rowLength + stripAlignment - 1) / stripAlignment);
+		columnStripWidth = ((rowLength + columnStripCount - 1) / columnStripCount + stripAlignment - 1) / stripAlignment * stripAlignment;
+
+		if (builder == BuilderDeferred) {
+			sourceImage = image;
+			sourceCensorMap = censorMap;
+			builtColumnStripCount = 0;
+			return;
+		}
+
+		// pass 1 : independent prefix sums along each row
+		int y;
+		#pragma omp parallel for num_threads(threadCount) schedule(static)
+		for (y = 0; y < image.rows; y++) {
+			createRowPrefixSums<TI2, TC>(image, censorMap, intervalCount, y);
+		}
+
+		// pass 2 : accumulate rows downwards, independent (and contiguous) column strips
+		int strip;
+		#pragma omp parallel for num_threads(threadCount) schedule(static)
+		for (strip = 0; strip < columnStripCount; strip++) {
+			accumulateColumns<TI2, TC>(image.rows, intervalCount, strip * columnStripWidth, min((strip + 1) * columnStripWidth, rowLength));
+		}
+	}
+
+	void allocateIntegralImages(Mat& image, int intervalCount, int I2type, int Ctype)
+	{
+		if (layout == LayoutPlanar) {
+			I2 = TileArena::allocate(arena, image.rows * intervalCount, image.cols, I2type);
+			C = TileArena::allocate(arena, image.rows * intervalCount, image.cols, Ctype);
+
+			pixelStride = 1;
+			intervalStride = (image.cols * image.rows);
+		}
+		else {
+			I2 = TileArena::allocate(arena, image.rows, image.cols * intervalCount, I2type);
+			C = TileArena::allocate(arena, image.rows, image.cols * intervalCount, Ctype);
+
+			pixelStride = intervalCount;
+			intervalStride = 1;
+		}
+	}
+
+	template<typename TI2, typename TC>
+	void createIntegralImagesByRecurrence(Mat& image, Mat& censorMap, int intervalCount, int* intervalIndices)
+	{
 		for (int y = 0; y<image.rows; y++) {
 			T* imageRow = (T*)(image.data + y * image.step);
 			unsigned char* censoringRow = (unsigned char*)(censorMap.data + y  * censorMap.step);
 
-			double* I2row = (double*)(I2.data + y * I2.step);
-			double* I2rowUp = (y > 0 ? (double*)(I2.data + (y - 1) * I2.step) : NULL);
+			TI2* I2row = (TI2*)(I2.data + y * I2.step);
+			TI2* I2rowUp = (y > 0 ? (TI2*)(I2.data + (y - 1) * I2.step) : NULL);
 
-			int* Crow = (int*)(C.data + y * C.step);
-			int* CrowUp = (y > 0 ? (int*)(C.data + (y - 1) * C.step) : NULL);
+			TC* Crow = (TC*)(C.data + y * C.step);
+			TC* CrowUp = (y > 0 ? (TC*)(C.data + (y - 1) * C.step) : NULL);
 
 			for (int x = 0; x<image.cols; x++) {
 				const bool isNotCensored = (imageRow[x] > 0 && censoringRow[x] == 0);
 				const T pixelvalue = (isNotCensored ? imageRow[x] : 0);
 
+				unsigned int membership = 0;
+
 				int intervalShift = 0;
 				for (int intervalIndex=1; intervalIndex<=intervalCount; intervalIndex++) {
 					const int intervalStart = intervalIndices[intervalIndex - 1];
@@ -69,19 +262,108 @@ private:
 
 					const bool isInInterval = (pixelvalue >= intervalStart && pixelvalue <= intervalEnd);
 
-					const int xShifted = x + intervalShift;
+					const int xShifted = x * pixelStride + intervalShift;
+					const int xShiftedLeft = xShifted - pixelStride;
 
-					I2row[xShifted] = (isInInterval ? MathUtilities::sqr<double>(pixelvalue) : 0)
-									+ (x > 0 ? I2row[xShifted - 1] : 0)
+					I2row[xShifted] = (TI2)((isInInterval ? (TI2)MathUtilities::sqr<double>(pixelvalue) : 0)
+									+ (x > 0 ? I2row[xShiftedLeft] : 0)
 									+ (y > 0 ? I2rowUp[xShifted] : 0)
-									- (x > 0 && y > 0 ? I2rowUp[xShifted - 1] : 0);
+									- (x > 0 && y > 0 ? I2rowUp[xShiftedLeft] : 0));
 
-					Crow[xShifted] = (isInInterval && isNotCensored ? 1 : 0)
-									+ (x > 0 ? Crow[xShifted - 1] : 0)
+					Crow[xShifted] = (TC)((isInInterval && isNotCensored ? 1 : 0)
+									+ (x > 0 ? Crow[xShiftedLeft] : 0)
 									+ (y > 0 ? CrowUp[xShifted] : 0)
-									- (x >0 && y > 0 ? CrowUp[xShifted - 1] : 0);
+									- (x >0 && y > 0 ? CrowUp[xShiftedLeft] : 0));
+
+					membership |= (isInInterval && isNotCensored ? 1u << (intervalIndex - 1) : 0);
+
+					intervalShift += intervalStride;
+				}
+
+				if (intervalMembership.type() == CV_8UC1)
+					intervalMembership.at<unsigned char>(y, x) = (unsigned char)membership;
+				else
+					intervalMembership.at<unsigned int>(y, x) = membership;
+			}
+		}
+	}
+
+	// the interval membership of each pixel is looked up once, then its square and count are added to the member intervals only
+	template<typename TI2, typename TC>
+	void createRowPrefixSums(Mat& image, Mat& censorMap, int intervalCount, int y)
+	{
+		T* imageRow = (T*)(image.data + y * image.step);
+		unsigned char* censoringRow = (unsigned char*)(censorMap.data + y  * censorMap.step);
+
+		TI2* I2row = (TI2*)(I2.data + y * I2.step);
+		TC* Crow = (TC*)(C.data + y * C.step);
+
+		const bool isByteMembership = (intervalMembership.type() == CV_8UC1);
+		unsigned char* membershipRow8 = (unsigned char*)(intervalMembership.data + y * intervalMembership.step);
+		unsigned int* membershipRow32 = (unsigned int*)(intervalMembership.data + y * intervalMembership.step);
+
+		const unsigned int* membershipTable = (unsigned int*)intervalMembershipTable.data;
+		const int membershipTableSize = intervalMembershipTable.cols;
+
+		for (int x = 0; x<image.cols; x++) {
+			const bool isNotCensored = (imageRow[x] > 0 && censoringRow[x] == 0);
+			const int tableIndex = (isNotCensored ? (int)imageRow[x] : 0);
+			const unsigned int membership = (isNotCensored && tableIndex < membershipTableSize ? membershipTable[tableIndex] : 0);
+
+			if (isByteMembership)
+				membershipRow8[x] = (unsigned char)membership;
+			else
+				membershipRow32[x] = membership;
+
+			const int xShifted = x * pixelStride;
+			const int xShiftedLeft = xShifted - pixelStride;
+
+			// carry the running sums of all intervals
+			int intervalShift = 0;
+			for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+				I2row[xShifted + intervalShift] = (x > 0 ? I2row[xShiftedLeft + intervalShift] : 0);
+				Crow[xShifted + intervalShift] = (x > 0 ? Crow[xShiftedLeft + intervalShift] : 0);
+
+				intervalShift += intervalStride;
+			}
+
+			// scatter into member intervals
+			if (membership != 0) {
+				const TI2 pixelvalueSqr = (TI2)MathUtilities::sqr<double>(tableIndex);
+
+				intervalShift = xShifted;
+				for (unsigned int bits = membership; bits != 0; bits >>= 1) {
+					if (bits & 1) {
+						I2row[intervalShift] += pixelvalueSqr;
+						Crow[intervalShift] += 1;
+					}
+
+					intervalShift += intervalStride;
+				}
+			}
+		}
+	}
+
+	// adds each SAT row to the following one for the row elements [x1, x2)
+	template<typename TI2, typename TC>
+	void accumulateColumns(int height, int intervalCount, int x1, int x2)
+	{
+		const int slabCount = (layout == LayoutPlanar ? intervalCount : 1);
+
+		for (int slab = 0; slab < slabCount; slab++) {
+			for (int y = slab * height + 1; y < (slab + 1) * height; y++) {
+				TI2* I2row = (TI2*)(I2.data + y * I2.step);
+				TI2* I2rowUp = (TI2*)(I2.data + (y - 1) * I2.step);
+
+				TC* Crow = (TC*)(C.data + y * C.step);
+				TC* CrowUp = (TC*)(C.data + (y - 1) * C.step);
+
+				for (int x = x1; x < x2; x++) {
+					I2row[x] += I2rowUp[x];
+				}
 
-					intervalShift += intervalShiftPerInterval;
+				for (int x = x1; x < x2; x++) {
+					Crow[x] += CrowUp[x];
 				}
 			}
 		}
@@ -1,9 +1,22 @@
 #pragma once
 
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <intrin.h>
 
 class MathUtilities {
 public:
 
+	// AVX2 and FMA (which /arch:AVX2 code may use) are supported by the CPU and their registers are saved by the operating system
+	static bool isAVX2Supported()
+	{
+		static const bool isSupported = detectAVX2();
+
+		return isSupported;
+	}
+
 	template<typename T>
 	static inline T sqr(T x)
 	{
@@ -16,4 +29,95 @@ public:
 		return x * x * x;
 	}
 
+private:
+	static bool detectAVX2()
+	{
+		int cpuInfo[4];
+
+		__cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7) {
+			return false;
+		}
+
+		__cpuid(cpuInfo, 1);
+		const bool hasFMA = ((cpuInfo[2] & (1 << 12)) != 0);
+		const bool hasOSXSAVE = ((cpuInfo[2] & (1 << 27)) != 0);
+		const bool hasAVX = ((cpuInfo[2] & (1 << 28)) != 0);
+		if (!hasFMA || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+
+		__cpuidex(cpuInfo, 7, 0);
+
+		return ((cpuInfo[1] & (1 << 5)) != 0);
+	}
+
+};
+
+
+// exp(-t) for t >= 0 with a bounded relative error : exp(-t) = 2^-n * 2^-f where 2^-f (0 <= f < 1) is linearly interpolated from a table,
+// the table size is chosen from maximumRelativeError since linear interpolation of 2^-f with step h has relative error <= (h * ln(2))^2 / 8 * 2^h
+class ExponentialTable {
+public:
+	ExponentialTable(double maximumRelativeError = 1e-4)
+	{
+		const double ln2 = 0.69314718055994531;
+
+		this->maximumRelativeError = std::max(maximumRelativeError, 1e-12);
+		tableSize = std::max((int)std::ceil(1.05 * ln2 / std::sqrt(8.0 * this->maximumRelativeError)), 2);
+
+		table.resize(tableSize + 2);
+		for (int i = 0; i < tableSize + 2; i++) {
+			table[i] = std::pow(2.0, -(double)i / tableSize);
+		}
+	}
+
+	double getMaximumRelativeError() const
+	{
+		return maximumRelativeError;
+	}
+
+	int getTableSize() const
+	{
+		return tableSize;
+	}
+
+	// 2^(-i / tableSize) for i = 0 to tableSize + 1
+	const double* getTable() const
+	{
+		return table.data();
+	}
+
+	// exp(-t), t >= 0
+	inline double negativeExp(double t) const
+	{
+		// beyond 2^-1021 the result is taken as zero
+		const double maximumExponent = 1021.0;
+
+		const double u = t * 1.4426950408889634;
+		if (u >= maximumExponent) {
+			return 0.0;
+		}
+
+		const int n = (int)u;
+		const double position = (u - n) * tableSize;
+		const int index = (int)position;
+		const double weight = position - index;
+
+		const double p = table[index] + weight * (table[index + 1] - table[index]);
+
+		// 2^-n by writing 1023 - n into the exponent bits
+		const long long scaleBits = (long long)(1023 - n) << 52;
+		double scale;
+		memcpy(&scale, &scaleBits, sizeof(scale));
+
+		return p * scale;
+	}
+
+
+private:
+	double maximumRelativeError;
+	int tableSize;
+	std::vector<double> table;
+
 };
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <omp.h>
+#include <map>
+#include <vector>
+#include <cmath>
+#include "RayleighMixtureData.h"
+
+using namespace std;
+
+
+// Mixture fits of the tiles of an image keyed by a quantized, scale free signature of the censored tile histogram (percentiles relative to the median
+// and the second moment relative to the squared mean). Tiles of homogeneous scenes (sea, farmland) share a signature, so a tile whose signature is
+// cached takes over that solution (see DetermineMixtureParameters::apply) instead of annealing. The tolerance is the quantization step of the relative
+// values, if several tiles fall into a cell the fit that finishes first is reused by the tiles looked up after it, which depends on the thread
+// scheduling, so with more than one thread the results may differ between runs.
+class MixtureFitCache {
+public:
+	MixtureFitCache(double tolerance)
+	{
+		this->tolerance = tolerance;
+		hitCount = 0;
+		missCount = 0;
+
+		omp_init_lock(&lock);
+	}
+
+	virtual ~MixtureFitCache()
+	{
+		omp_destroy_lock(&lock);
+	}
+
+	// empty if the histogram has no spread (such data is not cached)
+	vector<int> createSignature(RayleighMixtureData& rayleighMixtureData) const
+	{
+		vector<int> signature;
+
+		const int medianIndex = rayleighMixtureData.getPercentileIndex(50.0);
+		if (medianIndex <= 0) {
+			return signature;
+		}
+
+		signature.push_back(rayleighMixtureData.histogramSize);
+		signature.push_back(rayleighMixtureData.dimension);
+
+		const double percentiles[] = { 10.0, 25.0, 75.0, 90.0, 99.0 };
+		for (int i = 0; i < 5; i++) {
+			signature.push_back(quantize((double)rayleighMixtureData.getPercentileIndex(percentiles[i]) / medianIndex));
+		}
+
+		double pdfSum = 0.0;
+		double firstMoment = 0.0;
+		double secondMoment = 0.0;
+		for (int k = 0; k < rayleighMixtureData.histogramSize; k++) {
+			pdfSum += rayleighMixtureData.pdfEmpirical[k];
+			firstMoment += k * rayleighMixtureData.pdfEmpirical[k];
+			secondMoment += (double)k * k * rayleighMixtureData.pdfEmpirical[k];
+		}
+		signature.push_back(quantize(secondMoment * pdfSum / (firstMoment * firstMoment)));
+
+		return signature;
+	}
+
+	// counts a hit or a miss
+	bool find(const vector<int>& signature, vector<double>& solution)
+	{
+		omp_set_lock(&lock);
+		map<vector<int>, vector<double>>::const_iterator entry = solutions.find(signature);
+		const bool isFound = (entry != solutions.end());
+		if (isFound) {
+			solution = entry->second;
+			hitCount++;
+		}
+		else {
+			missCount++;
+		}
+		omp_unset_lock(&lock);
+
+		return isFound;
+	}
+
+	// the first solution inserted for a signature is kept (the fit that finished first, not the lowest tile number)
+	void insert(const vector<int>& signature, const vector<double>& solution)
+	{
+		omp_set_lock(&lock);
+		solutions.insert(make_pair(signature, solution));
+		omp_unset_lock(&lock);
+	}
+
+	long long getHitCount() const
+	{
+		return hitCount;
+	}
+
+	long long getMissCount() const
+	{
+		return missCount;
+	}
+
+	double getTolerance() const
+	{
+		return tolerance;
+	}
+
+private:
+	double tolerance;
+	map<vector<int>, vector<double>> solutions;
+	long long hitCount;
+	long long missCount;
+	omp_lock_t lock;
+
+	int quantize(double value) const
+	{
+		return (int)floor(value / tolerance + 0.5);
+	}
+};
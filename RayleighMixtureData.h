@@ -3,6 +3,7 @@
 #include <opencv2\opencv.hpp>
 #include "MathUtilities.h"
 #include "ImageUtilities.h"
+#include "TileArena.h"
 
 using namespace std;
 using namespace cv;
@@ -16,6 +17,8 @@ public:
 	int dimension;
 	Mat histogram;
 
+	// storage of the arrays below
+	Mat arrays;
 	int* H;
 	double* pdfEmpirical;
 	double* pdfEstimated;
@@ -34,84 +37,85 @@ public:
 	double initialError;
 	double finalError;
 
-	RayleighMixtureData(Mat& image, Mat& globalHistogram, int histogramSize, int dimension, double probabilityOfFalseAlarm)
+	// annealed percentile steps of the intervals (empty for a single Rayleigh or if no valid mixture was found), see DetermineMixtureParameters
+	vector<double> solution;
+
+	// censoring thresholds, a pixel is censored if it exceeds reflectivityUpperBound or its median filtered value by more than contrastThreshold
+	double contrastThreshold;
+	double reflectivityUpperBound;
+
+	// noDataPixelCount : zero pixels the image was cropped by, they are counted in the histogram of the censoring threshold
+	// arena : the censor map and the arrays are allocated in it if it is given (see TileArena)
+	// threadCount : threads of the censoring and the histograms (the mixture fit is serial)
+	RayleighMixtureData(Mat& image, Mat& globalHistogram, int histogramSize, int dimension, double probabilityOfFalseAlarm, int noDataPixelCount = 0,
+		TileArena* arena = NULL, int threadCount = 1)
 	{
 		// create empirical histogram
-		Mat originalHistogram = ImageUtilities::createHistogram(image);
+		Mat originalHistogram = ImageUtilities::createHistogram(image, 0, threadCount);
+		if (noDataPixelCount > 0 && originalHistogram.cols > 1) {
+			originalHistogram.at<int>(0) += noDataPixelCount;
+		}
 
 		const int medianFilterSize = 3;
 		const double censoringPercentile = 0.20;
+
+		contrastThreshold = calculateContrastThreshold(globalHistogram, originalHistogram, censoringPercentile);
+		reflectivityUpperBound = 2.5 * histogramSize;
+
 		switch (image.type())
 		{
-		case CV_8U:  censorMap = createCensorMap<unsigned char>(image, globalHistogram, originalHistogram, medianFilterSize, censoringPercentile, histogramSize);		break;
-		case CV_8S:  censorMap = createCensorMap<char>(image, globalHistogram, originalHistogram, medianFilterSize, censoringPercentile, histogramSize);				break;
-		case CV_16U: censorMap = createCensorMap<unsigned short>(image, globalHistogram, originalHistogram, medianFilterSize, censoringPercentile, histogramSize);		break;
-		case CV_16S: censorMap = createCensorMap<short>(image, globalHistogram, originalHistogram, medianFilterSize, censoringPercentile, histogramSize);				break;
-		case CV_32S: censorMap = createCensorMap<int>(image, globalHistogram, originalHistogram, medianFilterSize, censoringPercentile, histogramSize);					break;
+		case CV_8U:  censorMap = createCensorMap<unsigned char>(image, medianFilterSize, contrastThreshold, reflectivityUpperBound, arena, threadCount);		break;
+		case CV_8S:  censorMap = createCensorMap<char>(image, medianFilterSize, contrastThreshold, reflectivityUpperBound, arena, threadCount);				break;
+		case CV_16U: censorMap = createCensorMap<unsigned short>(image, medianFilterSize, contrastThreshold, reflectivityUpperBound, arena, threadCount);		break;
+		case CV_16S: censorMap = createCensorMap<short>(image, medianFilterSize, contrastThreshold, reflectivityUpperBound, arena, threadCount);				break;
+		case CV_32S: censorMap = createCensorMap<int>(image, medianFilterSize, contrastThreshold, reflectivityUpperBound, arena, threadCount);					break;
 		default: censorMap = Scalar(0);
 		}
 
-		histogram = ImageUtilities::createHistogram(image, censorMap);
-
-		histogramSize = min(histogramSize, histogram.cols);
+		histogram = ImageUtilities::createHistogram(image, censorMap, threadCount);
 
 		this->image = image;
-		this->histogramSize = histogramSize;
-		this->dimension = dimension;
-
-		// create arrays
-		H = new int[histogramSize];
-		pdfEmpirical = new double[histogramSize];
-		pdfEstimated = new double[histogramSize];
-		Sn = new double[histogramSize];
-		Sd = new double[histogramSize];
-		Weights = new double[dimension];
-		Sigmas = new double[dimension];
-		sqrSigmas = new double[dimension];
-		intervals = new double[dimension + 2];
-		intervalCount = 0;
-
-		histogramSum = 0.0;
-		histogramMaximumOccurance = 0;
+		initialize(histogramSize, dimension, arena);
+	}
 
-		iterationCount = 0;
-		initialError = 0.0;
-		finalError = 0.0;
+	// mixture data of a histogram without image (e.g. the scene histogram as a seed of the tile fits), nothing is censored
+	RayleighMixtureData(Mat& histogram, int histogramSize, int dimension)
+	{
+		contrastThreshold = 0.0;
+		reflectivityUpperBound = 2.5 * histogramSize;
 
-		initializePDFandSATs(histogram);
+		this->histogram = histogram;
+		initialize(histogramSize, dimension, NULL);
 	}
 
 	virtual ~RayleighMixtureData()
 	{
-		delete[] H;
-		delete[] pdfEmpirical;
-		delete[] pdfEstimated;
-		delete[] Sn;
-		delete[] Sd;
-		delete[] Weights;
-		delete[] Sigmas;
-		delete[] sqrSigmas;
-		delete[] intervals;
 	}
 
-	template<typename T>
-	static Mat createCensorMap(Mat& image, Mat& globalHistogram, Mat& histogram, int medianFilterSize, double censoringPercentile, int histogramSize)
+	static double calculateContrastThreshold(Mat& globalHistogram, Mat& histogram, double censoringPercentile)
 	{
-		Mat censorMap(image.rows, image.cols, CV_8UC1);
-		//censorMap = Scalar(0);
-		//return censorMap;
-
-		Mat imageFiltered;
-		medianBlur(image, imageFiltered, medianFilterSize);
-
 		Mat fusedHistogram = fuseHistograms<int>(globalHistogram, histogram);
 
 		const double contrastPercentile = 1.0 - censoringPercentile;
 		const double contrastThreshold = ImageUtilities::getPercentileIndex<int>(fusedHistogram, contrastPercentile);
 
-		const double reflectivityUpperBound = 2.5 * histogramSize;
+		return contrastThreshold;
+	}
 
-		for (int y = 0; y < imageFiltered.rows; y++) {
+	template<typename T>
+	static Mat createCensorMap(Mat& image, int medianFilterSize, double contrastThreshold, double reflectivityUpperBound, TileArena* arena = NULL, int threadCount = 1)
+	{
+		Mat censorMap = TileArena::allocate(arena, image.rows, image.cols, CV_8UC1);
+		//censorMap = Scalar(0);
+		//return censorMap;
+
+		// medianBlur keeps a preallocated destination of the right size and type
+		Mat imageFiltered = TileArena::allocate(arena, image.rows, image.cols, image.type());
+		medianBlur(image, imageFiltered, medianFilterSize);
+
+		int y;
+		#pragma omp parallel for num_threads(max(threadCount, 1)) if (threadCount > 1) schedule(static)
+		for (y = 0; y < imageFiltered.rows; y++) {
 			T* irow = (T*)(image.data + y * image.step);
 			T* ifrow = (T*)(imageFiltered.data + y * imageFiltered.step);
 			unsigned char* cmap = (unsigned char*)(censorMap.data + y * censorMap.step);
@@ -230,4 +234,36 @@ public:
 		return pair<double, double>(phatSqr, sumOfPdf);
 	}
 
+private:
+	// arrays and pdf of the histogram
+	void initialize(int histogramSize, int dimension, TileArena* arena)
+	{
+		histogramSize = min(histogramSize, histogram.cols);
+
+		this->histogramSize = histogramSize;
+		this->dimension = dimension;
+
+		// create arrays (in a single block)
+		arrays = TileArena::allocate(arena, 1, 4 * histogramSize + 4 * dimension + 2 + (histogramSize + 1) / 2, CV_64FC1);
+		pdfEmpirical = (double*)arrays.data;
+		pdfEstimated = pdfEmpirical + histogramSize;
+		Sn = pdfEstimated + histogramSize;
+		Sd = Sn + histogramSize;
+		Weights = Sd + histogramSize;
+		Sigmas = Weights + dimension;
+		sqrSigmas = Sigmas + dimension;
+		intervals = sqrSigmas + dimension;
+		H = (int*)(intervals + dimension + 2);
+		intervalCount = 0;
+
+		histogramSum = 0.0;
+		histogramMaximumOccurance = 0;
+
+		iterationCount = 0;
+		initialError = 0.0;
+		finalError = 0.0;
+
+		initializePDFandSATs(histogram);
+	}
+
 };
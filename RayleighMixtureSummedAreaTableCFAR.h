@@ -3,7 +3,11 @@
 #include <iostream>
 #include <opencv2\opencv.hpp>
 #include "TileManager.h"
+#include "TileGeometryPlanner.h"
 #include "SummedAreaTableTargetDetector.h"
+#include "TargetBlobExtractor.h"
+#include "TileTaskScheduler.h"
+#include "TileArena.h"
 #include "TargetDetectorConsoleLogger.h"
 #include "targetDetectors\AbstractCFAR.h"
 
@@ -17,107 +21,820 @@ public:
 	{
 	}
 
+	virtual ~RayleighMixtureSummedAreaTableCFAR()
+	{
+		releaseCache();
+	}
+
 	virtual AbstractCFAR* clone()
 	{
 		return new RayleighMixtureSummedAreaTableCFAR;
 	}
 
 	virtual Mat execute(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters)
+	{
+		return detectTiles(image, probabilityOfFalseAlarm, parameters, false, NULL, NULL);
+	}
+
+	// no full-size target map is allocated, each tile thread collects its targets (with their false alarm probability) in its own buffer
+	virtual vector<TargetDetection> executeDetectionList(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters)
+	{
+		vector<TargetDetection> detections;
+		detectTiles(image, probabilityOfFalseAlarm, parameters, false, &detections, NULL);
+
+		return detections;
+	}
+
+	// connected target pixels with their attributes, labelled per tile in the detection threads and merged across the tile seams afterwards
+	vector<TargetBlob> executeBlobs(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters)
+	{
+		vector<TargetBlob> blobs;
+		detectTiles(image, probabilityOfFalseAlarm, parameters, false, NULL, &blobs);
+
+		return blobs;
+	}
+
+	// the probabilities do not depend on Pfa, so one map serves every operating point (see applyProbabilityOfFalseAlarm)
+	virtual Mat executeProbabilityMap(Mat image, map<string, double>& parameters)
+	{
+		return detectTiles(image, 1.0, parameters, true, NULL, NULL);
+	}
+
+	virtual int getClutterArea(map<string, double>& parameters)
+	{
+		const int guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
+		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
+		const int windowRadius = (guardRadius + clutterRadius);
+
+		const int clutterArea = sqr(2 * windowRadius + 1) - sqr(2 * guardRadius + 1);
+
+		return clutterArea;
+	}
+
+	virtual int getBandWidth(map<string, double>& parameters)
+	{
+		const int guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
+		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
+		const int windowRadius = (guardRadius + clutterRadius);
+
+		return calculateBandSize(windowRadius);
+	}
+
+	// RmSAT-CFAR.tileWidth and RmSAT-CFAR.tileHeight (0 : same as the width), the geometry is planned for the image if the width is 0
+	Size getTileSize(Size imageSize, map<string, double>& parameters)
+	{
+		const int tileWidth = (int)getParameterValue(parameters, "RmSAT-CFAR.tileWidth", 0);
+		const int tileHeight = (int)getParameterValue(parameters, "RmSAT-CFAR.tileHeight", 0);
+
+		if (tileWidth > 0) {
+			return Size(tileWidth, (tileHeight > 0 ? tileHeight : tileWidth));
+		}
+
+		// the planned geometry depends on the machine (caches and threads), so it is printed
+		const Size plannedTileSize = createTileGeometryPlanner(parameters).plan(imageSize);
+		cout << "Tile geometry : " << plannedTileSize.width << "x" << plannedTileSize.height << " planned for " << getThreadCount() << " threads" << endl;
+
+		return plannedTileSize;
+	}
+
+	TileGeometryPlanner createTileGeometryPlanner(map<string, double>& parameters)
 	{
 		const int guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
 		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
-		const int minimumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.minimumMixtureCount", 1);
 		const int maximumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.maximumMixtureCount", 5);
+		const bool validateCompactStorage = (getParameterValue(parameters, "RmSAT-CFAR.validateCompactStorage", 0) != 0);
+		const bool taskScheduling = (getParameterValue(parameters, "RmSAT-CFAR.taskScheduling", 1) != 0 && !validateCompactStorage);
+		const bool compactStorage = (getParameterValue(parameters, "RmSAT-CFAR.integralImageStorage", StorageDouble) == StorageCompact);
+
+		// the cache sizes do not change while the program runs
+		static const CacheHierarchy cacheHierarchy = CacheHierarchy::detect();
+
+		return TileGeometryPlanner(cacheHierarchy, getThreadCount(), maximumMixtureCount, guardRadius + clutterRadius, getBandWidth(parameters), taskScheduling, compactStorage);
+	}
+
+	virtual bool isDeterministic() const { return false; }
+
+	virtual bool requiresGlobalHistogram() const { return true; }
+
+	virtual void releaseCache()
+	{
+		for (int i = 0; i < tileCache.size(); i++) {
+			delete tileCache.at(i);
+		}
+		tileCache.clear();
+
+		cachedImage = Mat();
+		cachedParameters.clear();
+		cachedGlobalHistogram = Mat();
+		cachedCellDataRectangles.clear();
+	}
+
+private:
+	// per-tile intermediates kept between execute calls if RmSAT-CFAR.cacheTileData is set
+	Mat cachedImage;
+	map<string, double> cachedParameters;
+	Mat cachedGlobalHistogram;
+	vector<Rect> cachedCellDataRectangles;
+	vector<TileCacheEntry*> tileCache;
+
+	// stages of a tile in task scheduling, SAT rows and detection are split into row bands and SAT columns into strips
+	enum TileTaskStage { StagePrepare, StageIntegralImageRows, StageIntegralImageColumns, StageDetect };
+
+	struct TileTaskState {
+		Mat inputTile;
+		Mat resultTile;
+		TileCacheEntry* tileCacheEntry;
+		TileArena* tileArena;
+		int remainingSubtaskCount;
+	};
+
+	// Seeds of the tile fits. A seeded fit waits for the fits of its seed tiles (warm start : a fixed neighbour, anchor interpolation : the surrounding
+	// anchor tiles) and starts from the weighted mean of their solutions, without seed tiles from the scene solution (if any). The seed tiles are fixed
+	// by the geometry, so the seeds do not depend on the scheduling.
+	struct MixtureSeeding {
+		vector<vector<int>> seedTiles;
+		vector<vector<double>> seedWeights;
+		vector<vector<int>> seededTiles;
+		vector<int> remainingSeedCounts;
+		vector<vector<double>> solutions;
+		vector<double> errors;
+		vector<double> sceneSolution;
+		bool isInterpolation;
+		double interpolationMargin;
+	};
+
+	// everything a tile task needs, shared by all threads
+	struct TileTaskContext {
+		TileManager* tileManager;
+		vector<pair<int, int>> tileIndices;
+		vector<TileTaskState> tileStates;
+		TileTaskScheduler* scheduler;
+		TileArenaPool* tileArenaPool;
+		Mat image;
+		Mat globalHistogram;
+		double probabilityOfFalseAlarm;
+		bool isProbabilityMap;
+		int resultType;
+		bool cacheTileData;
+		int guardRadius;
+		int windowRadius;
+		int bandHeight;
+		int fitThreadCount;
+		MixtureSeeding* mixtureSeeding;
+		vector<vector<TargetDetection>>* threadDetections;
+		vector<TileBlobs>* tileBlobs;
+		vector<double> tileTimes;
+	};
+
+	// target map (CV_8U) or, if isProbabilityMap is set, probability map (CV_32F) of the image, if detections (blobs) is given the targets (target blobs)
+	// are listed there in raster order and an empty map is returned
+	Mat detectTiles(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters, bool isProbabilityMap, vector<TargetDetection>* detections,
+		vector<TargetBlob>* blobs)
+	{
+		const int guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
+		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
+		const bool validateCompactStorage = (getParameterValue(parameters, "RmSAT-CFAR.validateCompactStorage", 0) != 0);
+		const bool cacheTileData = (getParameterValue(parameters, "RmSAT-CFAR.cacheTileData", 0) != 0);
+		const bool taskScheduling = (getParameterValue(parameters, "RmSAT-CFAR.taskScheduling", 1) != 0 && !validateCompactStorage);
+		const bool tileOrdering = (getParameterValue(parameters, "RmSAT-CFAR.tileOrdering", 1) != 0);
+		const bool logTileCosts = (getParameterValue(parameters, "RmSAT-CFAR.logTileCosts", 0) != 0);
+		const int maximumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.maximumMixtureCount", 5);
+		const bool occupancyIndex = (getParameterValue(parameters, "RmSAT-CFAR.occupancyIndex", 1) != 0);
+		const bool useTileArenas = (getParameterValue(parameters, "RmSAT-CFAR.tileArena", 1) != 0 && !cacheTileData);
+		const bool largePages = (getParameterValue(parameters, "RmSAT-CFAR.largePages", 0) != 0);
+		const FittingMode fittingMode = (FittingMode)(int)getParameterValue(parameters, "RmSAT-CFAR.fittingMode", FittingCold);
+		const int warmStartRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.warmStartRadius", 2);
+		const double fitCacheTolerance = getParameterValue(parameters, "RmSAT-CFAR.fitCacheTolerance", 0.0);
+		const int anchorSpacing = (int)getParameterValue(parameters, "RmSAT-CFAR.anchorSpacing", 2);
+		const double interpolationMargin = getParameterValue(parameters, "RmSAT-CFAR.interpolationMargin", 0.1);
+		const int requestedQuadtreeLevels = (blobs == NULL ? max((int)getParameterValue(parameters, "RmSAT-CFAR.quadtreeLevels", 0), 0) : 0);
+		const double quadtreeTolerance = getParameterValue(parameters, "RmSAT-CFAR.quadtreeTolerance", 0.2);
 
 		// fit histogram into mixture of Rayleighs
-		const int tileSize = 1024;
 		const int bandSize = getBandWidth(parameters);
+		const Size plannedTileSize = getTileSize(image.size(), parameters);
+
+		// quadtree tiles range from cells of the planned size / 2^levels in heterogeneous clutter up to the planned size * 2^levels in homogeneous
+		// clutter (blob seams are only matched between the tiles of a regular grid), the levels are clamped so the cells stay at least as wide and high
+		// as the band and as large as the smallest tile the planner gives a mixture fit
+		const int minimumCellPixelCount = createTileGeometryPlanner(parameters).getMinimumTilePixelCount();
+		int quadtreeLevels = 0;
+		while (quadtreeLevels < requestedQuadtreeLevels) {
+			const Size cellSize(plannedTileSize.width >> (quadtreeLevels + 1), plannedTileSize.height >> (quadtreeLevels + 1));
+			if (min(cellSize.width, cellSize.height) < bandSize || cellSize.area() < minimumCellPixelCount) {
+				break;
+			}
+			quadtreeLevels++;
+		}
+		if (quadtreeLevels < requestedQuadtreeLevels) {
+			cout << "Quadtree levels : " << requestedQuadtreeLevels << " clamped to " << quadtreeLevels << " (cells of at least " << bandSize << " pixels per side and "
+				<< minimumCellPixelCount << " pixels, tile size " << plannedTileSize.width << "x" << plannedTileSize.height << ")" << endl;
+		}
+		const Size tileSize(max(plannedTileSize.width >> quadtreeLevels, 1), max(plannedTileSize.height >> quadtreeLevels, 1));
 
-		TileManager tileManager(image, tileSize, bandSize, CV_8UC1);
+		const int resultType = (isProbabilityMap ? CV_32FC1 : CV_8UC1);
+		TileManager tileManager(image, tileSize, bandSize, resultType, (detections == NULL && blobs == NULL));
+		if (quadtreeLevels > 0) {
+			tileManager.mergeHomogeneousCells(1 << (2 * quadtreeLevels), quadtreeTolerance);
+		}
 		vector<pair<int, int>> tileIndices = tileManager.getTileIndices();
-
-		const int threadCount = min(getThreadCount(), (int)tileIndices.size());
+		const Size largestTileSize = tileManager.getLargestTileSize();
 
 		omp_set_nested(1);
 
-		Mat globalHistogram = createHistogram(image, tileSize, threadCount);
-
-		TargetDetectorConsoleLogger targetDetectorConsoleLogger;
+		// the cache is keyed by the image buffer and the parameters, only the probability of false alarm may change between calls
+		if (cacheTileData && !isCacheValid(image, parameters, (int)tileIndices.size())) {
+			releaseCache();
 
-		int i;
-		Rect workingRect;
-		Mat inputTile;
-		Mat targetTile;
-		pair<int, int> tileIndex;
-		SummedAreaTableTargetDetector* targetDetector = NULL;
-		#pragma omp parallel private(targetDetector) num_threads(threadCount)
-		{
-			targetDetector = new SummedAreaTableTargetDetector(minimumMixtureCount, maximumMixtureCount, guardRadius, clutterRadius);
-			
-			// set logger
-			///targetDetector->setLogger(&targetDetectorConsoleLogger);
+			cachedImage = image;
+			cachedParameters = parameters;
+			cachedGlobalHistogram = createHistogram(image, tileSize, getThreadCount(), (occupancyIndex ? &cachedCellDataRectangles : NULL));
+			tileCache.assign(tileIndices.size(), NULL);
+		}
 
-			#pragma omp for private(i, tileIndex, inputTile, targetTile, workingRect) schedule(dynamic, 1)
-			for (i = 0; i<tileIndices.size(); i++) {
-				tileIndex = tileIndices.at(i);
+		vector<Rect> cellDataRectangles;
+		Mat globalHistogram = (cacheTileData ? cachedGlobalHistogram : createHistogram(image, tileSize, getThreadCount(), (occupancyIndex ? &cellDataRectangles : NULL)));
+		if (cacheTileData) {
+			cellDataRectangles = cachedCellDataRectangles;
+		}
 
-				workingRect = tileManager.getTileWorkingRectangle(tileIndex);
+		// tiles without data are neither fitted nor scanned and the others are cropped to their data, the result pixels left out keep the no-data result
+		if (occupancyIndex) {
+			tileManager.setOccupancyIndex(cellDataRectangles);
+		}
+		if (isProbabilityMap) {
+			tileManager.fillResultImage(1.0);
+		}
 
-				inputTile = createRayleighCompliantTile(tileManager.getInputTile(tileIndex));
-				if (targetTile.cols != inputTile.cols || targetTile.rows != inputTile.rows) {
-					targetTile = Mat(inputTile.rows, inputTile.cols, CV_8UC1);
+		// the most expensive tiles are started first, so no thread is left with a long tile while the others are idle
+		vector<TileCostEstimate> costEstimates;
+		vector<int> tileOrder(tileIndices.size());
+		for (int i = 0; i < tileOrder.size(); i++) {
+			tileOrder[i] = i;
+		}
+		if (tileOrdering || logTileCosts) {
+			costEstimates = tileManager.estimateTileCosts(maximumMixtureCount);
+		}
+		if (tileOrdering) {
+			tileOrder = TileManager::getTileOrder(costEstimates);
+		}
+		tileOrder.erase(remove_if(tileOrder.begin(), tileOrder.end(), [&](int i) { return tileManager.isTileEmpty(tileIndices[i]); }), tileOrder.end());
+
+		// seeded fits of a level only start once the previous level is fitted (empty tiles seed nothing)
+		MixtureSeeding mixtureSeeding;
+		mixtureSeeding.seedTiles.resize(tileIndices.size());
+		mixtureSeeding.seedWeights.resize(tileIndices.size());
+		mixtureSeeding.seededTiles.resize(tileIndices.size());
+		mixtureSeeding.remainingSeedCounts.assign(tileIndices.size(), 0);
+		mixtureSeeding.solutions.resize(tileIndices.size());
+		mixtureSeeding.errors.assign(tileIndices.size(), 0.0);
+		mixtureSeeding.isInterpolation = (fittingMode == FittingAnchorInterpolation);
+		mixtureSeeding.interpolationMargin = interpolationMargin;
+
+		// seeds are picked on the regular grid, quadtree tiles are fitted from scratch
+		vector<int> levelStarts(1, 0);
+		if ((fittingMode == FittingWarmStart || fittingMode == FittingAnchorInterpolation) && quadtreeLevels == 0) {
+			vector<int> seedLevels(tileIndices.size(), 0);
+			vector<int> seedTiles;
+			vector<double> seedWeights;
+			for (int k = 0; k < tileOrder.size(); k++) {
+				const int i = tileOrder[k];
+
+				seedTiles.clear();
+				seedWeights.clear();
+				if (fittingMode == FittingWarmStart) {
+					const int seedTile = tileManager.getSeedTileNumber(i, warmStartRadius, &seedLevels[i]);
+					if (seedTile >= 0) {
+						seedTiles.push_back(seedTile);
+						seedWeights.push_back(1.0);
+					}
+				}
+				else {
+					tileManager.getAnchorTiles(i, anchorSpacing, seedTiles, seedWeights);
+					if (seedTiles.size() == 1 && seedTiles[0] == i) {
+						seedTiles.clear();
+					}
+					seedLevels[i] = (seedTiles.empty() ? 0 : 1);
 				}
 
-				targetDetector->execute(inputTile, targetTile, globalHistogram, probabilityOfFalseAlarm, workingRect);
+				for (int j = 0; j < seedTiles.size(); j++) {
+					if (!tileManager.isTileEmpty(tileIndices[seedTiles[j]])) {
+						mixtureSeeding.seedTiles[i].push_back(seedTiles[j]);
+						mixtureSeeding.seedWeights[i].push_back(seedWeights[j]);
+						mixtureSeeding.seededTiles[seedTiles[j]].push_back(i);
+					}
+				}
+				mixtureSeeding.remainingSeedCounts[i] = (int)mixtureSeeding.seedTiles[i].size();
+			}
 
-				tileManager.setResultTile(tileIndex, targetTile);
+			stable_sort(tileOrder.begin(), tileOrder.end(), [&seedLevels](int i1, int i2) { return seedLevels[i1] < seedLevels[i2]; });
+			for (int k = 1; k < tileOrder.size(); k++) {
+				if (seedLevels[tileOrder[k]] != seedLevels[tileOrder[k - 1]]) {
+					levelStarts.push_back(k);
+				}
 			}
+		}
+		levelStarts.push_back((int)tileOrder.size());
+
+		long long fitIterationCount = 0;
+		long long acceptedSeedCount = 0;
+
+		// with scene refinement a single full fit of the scene histogram seeds every tile fit, which then only refines it
+		if (fittingMode == FittingSceneRefinement) {
+			SummedAreaTableTargetDetector* targetDetector = createTargetDetector(parameters, 1);
+			Mat sceneHistogram = createRayleighCompliantHistogram(globalHistogram);
+
+			mixtureSeeding.sceneSolution = targetDetector->fitHistogramMixture(sceneHistogram);
+			fitIterationCount += targetDetector->getFitIterationCount();
 
 			delete targetDetector;
 		}
 
+		// tiles of homogeneous scenes share the fit of the first tile with their histogram signature
+		MixtureFitCache* mixtureFitCache = (fitCacheTolerance > 0.0 ? new MixtureFitCache(fitCacheTolerance) : NULL);
+
+		// wall time per tile (summed over the tasks of a tile)
+		vector<double> tileTimes(logTileCosts ? tileIndices.size() : 0);
+
+		// tasks keep every thread busy regardless of the tile count, otherwise the threads left over by the tiles work inside the tiles
+		const int threadCount = (taskScheduling ? getThreadCount() : max(min(getThreadCount(), (int)tileOrder.size()), 1));
+		const int intraTileThreadCount = (taskScheduling ? 1 : max(getThreadCount() / threadCount, 1));
+
+		long long validationMismatchCount = 0;
+
+		// merged after the parallel region, so threads never synchronize on the detections
+		vector<vector<TargetDetection>> threadDetections(detections != NULL ? threadCount : 0);
+		vector<TileBlobs> tileBlobs(blobs != NULL ? tileIndices.size() : 0);
+
+		// tile working memory is reserved once per call (cached tile data outlives the call, so it is allocated from the heap)
+		TileArenaPool* tileArenaPool = (useTileArenas ? new TileArenaPool(estimateTileArenaSize(image, largestTileSize, bandSize, maximumMixtureCount), largePages) : NULL);
+
+		if (taskScheduling) {
+			TileTaskScheduler scheduler(threadCount);
+
+			TileTaskContext context;
+			context.tileManager = &tileManager;
+			context.tileIndices = tileIndices;
+			context.tileStates.resize(tileIndices.size());
+			context.scheduler = &scheduler;
+			context.tileArenaPool = tileArenaPool;
+			context.image = image;
+			context.globalHistogram = globalHistogram;
+			context.probabilityOfFalseAlarm = probabilityOfFalseAlarm;
+			context.isProbabilityMap = isProbabilityMap;
+			context.resultType = resultType;
+			context.cacheTileData = cacheTileData;
+			context.guardRadius = guardRadius;
+			context.windowRadius = guardRadius + clutterRadius;
+			// bands are made thinner if there are too few tiles to give every thread a few bands (a single chip uses all threads)
+			const int tileRowCount = (int)tileOrder.size() * min(largestTileSize.height + 2 * bandSize, image.rows);
+			context.bandHeight = max(min(64, tileRowCount / (4 * threadCount)), 8);
+			context.fitThreadCount = max(threadCount / max((int)tileOrder.size(), 1), 1);
+			context.mixtureSeeding = &mixtureSeeding;
+			context.threadDetections = (detections != NULL ? &threadDetections : NULL);
+			context.tileBlobs = (blobs != NULL ? &tileBlobs : NULL);
+			context.tileTimes.assign(tileTimes.size(), 0.0);
+
+			// fits are taken from the shared queue in tile order, whatever follows a fit is pushed by the thread that did it (including the fits it seeds)
+			for (int k = 0; k < tileOrder.size(); k++) {
+				if (mixtureSeeding.remainingSeedCounts[tileOrder[k]] == 0) {
+					scheduler.pushShared(TileTask(StagePrepare, tileOrder[k]));
+				}
+			}
+
+			int threadNumber;
+			TileTask task;
+			SummedAreaTableTargetDetector* targetDetector = NULL;
+			#pragma omp parallel private(targetDetector, threadNumber, task) num_threads(threadCount)
+			{
+				threadNumber = omp_get_thread_num();
+				targetDetector = createTargetDetector(parameters, intraTileThreadCount);
+				targetDetector->setMixtureFitCache(mixtureFitCache);
+
+				while (scheduler.getTask(threadNumber, task)) {
+					executeTileTask(context, task, threadNumber, targetDetector);
+					scheduler.completeTask();
+				}
+
+				#pragma omp atomic
+				fitIterationCount += targetDetector->getFitIterationCount();
+				#pragma omp atomic
+				acceptedSeedCount += targetDetector->getAcceptedSeedCount();
+
+				delete targetDetector;
+			}
+
+			tileTimes = context.tileTimes;
+		}
+		else {
+			int i;
+			int k;
+			int level;
+			double startTime;
+			double acceptedSeedError;
+			vector<double> mixtureSeed;
+			Rect workingRect;
+			Mat inputTile;
+			Mat targetTile;
+			Mat targetBuffer;
+			pair<int, int> tileIndex;
+			TileCacheEntry** tileCacheEntry;
+			vector<TargetDetection>* tileDetections;
+			TileArena* tileArena = NULL;
+			SummedAreaTableTargetDetector* targetDetector = NULL;
+			#pragma omp parallel private(targetDetector, tileDetections, tileArena, level) num_threads(threadCount)
+			{
+				targetDetector = createTargetDetector(parameters, intraTileThreadCount);
+				targetDetector->setMixtureFitCache(mixtureFitCache);
+				tileDetections = (detections != NULL ? &threadDetections.at(omp_get_thread_num()) : NULL);
+				tileArena = (tileArenaPool != NULL ? tileArenaPool->acquire() : NULL);
+				targetDetector->setTileArena(tileArena);
+
+				// each level of warm-started fits is a loop of its own, the barrier at its end completes the seeds of the next level
+				for (level = 0; level + 1 < levelStarts.size(); level++) {
+					#pragma omp for private(k, i, startTime, acceptedSeedError, mixtureSeed, tileIndex, inputTile, targetTile, targetBuffer, workingRect, tileCacheEntry) schedule(dynamic, 1)
+					for (k = levelStarts[level]; k < levelStarts[level + 1]; k++) {
+						startTime = omp_get_wtime();
+						i = tileOrder[k];
+						tileIndex = tileIndices.at(i);
+
+						workingRect = tileManager.getTileWorkingRectangle(tileIndex);
+
+						tileCacheEntry = (cacheTileData ? &tileCache.at(i) : NULL);
+						if (tileCacheEntry != NULL && *tileCacheEntry != NULL)
+							inputTile = (*tileCacheEntry)->tile;
+						else
+							inputTile = createRayleighCompliantTile(tileManager.getInputTile(tileIndex), tileManager.getNoDataPixelCount(tileIndex), tileArena, intraTileThreadCount);
+						targetDetector->setNoDataPixelCount(tileManager.getNoDataPixelCount(tileIndex));
+						mixtureSeed = getMixtureSeed(mixtureSeeding, i, acceptedSeedError);
+						targetDetector->setMixtureSeed(mixtureSeed, acceptedSeedError);
+
+						// results are written in place into the result image, sparse outputs use a buffer of the thread
+						targetTile = tileManager.getResultTile(tileIndex);
+						if (targetTile.empty()) {
+							if (targetBuffer.cols != inputTile.cols || targetBuffer.rows != inputTile.rows) {
+								targetBuffer = Mat(inputTile.rows, inputTile.cols, resultType);
+							}
+							targetTile = targetBuffer;
+						}
+
+						if (isProbabilityMap)
+							targetDetector->executeProbabilityMap(inputTile, targetTile, globalHistogram, workingRect, tileCacheEntry);
+						else if (tileDetections != NULL) {
+							const size_t firstDetection = tileDetections->size();
+							targetDetector->executeDetectionList(inputTile, targetTile, globalHistogram, probabilityOfFalseAlarm, *tileDetections, workingRect, tileCacheEntry);
+
+							moveDetectionsToImage(*tileDetections, firstDetection, tileManager.getInputTileOrigin(tileIndex), image);
+						}
+						else if (blobs != NULL) {
+							Mat valueTile = tileManager.getInputTile(tileIndex);
+							targetDetector->executeBlobs(inputTile, valueTile, targetTile, globalHistogram, probabilityOfFalseAlarm, tileBlobs.at(i), workingRect, tileCacheEntry);
+
+							TargetBlobExtractor::translate(tileBlobs.at(i), tileManager.getInputTileOrigin(tileIndex));
+						}
+						else
+							targetDetector->execute(inputTile, targetTile, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry);
+						mixtureSeeding.solutions[i] = targetDetector->getMixtureSolution();
+						mixtureSeeding.errors[i] = targetDetector->getMixtureError();
+
+						// the tile data is released, so its working memory is reused by the next tile
+						if (tileArena != NULL) {
+							inputTile = Mat();
+							tileArena->reset();
+						}
+
+						if (logTileCosts) {
+							tileTimes[i] = omp_get_wtime() - startTime;
+						}
+					}
+				}
+
+				#pragma omp atomic
+				validationMismatchCount += targetDetector->getValidationMismatchCount();
+				#pragma omp atomic
+				fitIterationCount += targetDetector->getFitIterationCount();
+				#pragma omp atomic
+				acceptedSeedCount += targetDetector->getAcceptedSeedCount();
+
+				if (tileArena != NULL) {
+					tileArenaPool->release(tileArena);
+				}
+				delete targetDetector;
+			}
+		}
+
+		if (tileArenaPool != NULL && largePages) {
+			cout << "Tile arenas : " << tileArenaPool->getLargePageArenaCount() << " of " << tileArenaPool->getArenaCount() << " on large pages"
+				<< (TileArenaPool::enableLockMemoryPrivilege() ? "" : " (the Lock pages in memory privilege is not granted)") << endl;
+		}
+		delete tileArenaPool;
+
+		if (mixtureFitCache != NULL) {
+			cout << "Mixture fit cache : " << mixtureFitCache->getHitCount() << " hits, " << mixtureFitCache->getMissCount() << " misses (tolerance "
+				<< mixtureFitCache->getTolerance() << ")" << endl;
+			delete mixtureFitCache;
+		}
+
+		if (validateCompactStorage) {
+			cout << "Compact SAT storage validation : " << validationMismatchCount << " decisions differ from double precision SATs" << endl;
+		}
+
+		if (logTileCosts) {
+			printTileCosts(tileIndices, costEstimates, tileTimes);
+			cout << "Mixture fits : " << fitIterationCount << " annealing iterations, " << acceptedSeedCount << " seeds taken without annealing" << endl;
+		}
+
+		if (detections != NULL) {
+			*detections = TargetDetectionList::merge(threadDetections);
+		}
+
+		if (blobs != NULL) {
+			*blobs = TargetBlobExtractor::mergeTileBlobs(tileBlobs, tileManager);
+		}
+
 		Mat targetMap = tileManager.getResultImage();
 
 		return targetMap;
 	}
 
-	virtual int getClutterArea(map<string, double>& parameters)
+	SummedAreaTableTargetDetector* createTargetDetector(map<string, double>& parameters, int intraTileThreadCount)
 	{
-		const int guardRadius = (int)parameters["RmSAT-CFAR.guardRadius"];
-		const int clutterRadius = (int)parameters["RmSAT-CFAR.clutterRadius"];
-		const int windowRadius = (guardRadius + clutterRadius);
+		const int guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
+		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
+		const int minimumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.minimumMixtureCount", 1);
+		const int maximumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.maximumMixtureCount", 5);
 
-		const int clutterArea = sqr(2 * windowRadius + 1) - sqr(2 * guardRadius + 1);
+		SummedAreaTableTargetDetector* targetDetector = new SummedAreaTableTargetDetector(minimumMixtureCount, maximumMixtureCount, guardRadius, clutterRadius);
+		targetDetector->setIntegralImageLayout((IntegralImageLayout)(int)getParameterValue(parameters, "RmSAT-CFAR.integralImageLayout", LayoutInterleaved));
+		targetDetector->setIntegralImageStorage((IntegralImageStorage)(int)getParameterValue(parameters, "RmSAT-CFAR.integralImageStorage", StorageDouble));
+		targetDetector->setValidateCompactStorage(getParameterValue(parameters, "RmSAT-CFAR.validateCompactStorage", 0) != 0);
+		targetDetector->setIntraTileThreadCount(intraTileThreadCount);
+		targetDetector->setVectorizedDetection(getParameterValue(parameters, "RmSAT-CFAR.vectorizedDetection", 1) != 0);
+		targetDetector->setExponentialRelativeError(getParameterValue(parameters, "RmSAT-CFAR.exponentialRelativeError", 0.0));
+		targetDetector->setPrescreening(getParameterValue(parameters, "RmSAT-CFAR.prescreening", 1) != 0);
 
-		return clutterArea;
+		// set logger
+		///targetDetector->setLogger(&targetDetectorConsoleLogger);
+
+		return targetDetector;
 	}
 
-	virtual int getBandWidth(map<string, double>& parameters)
+	// runs one stage of a tile and pushes the next stage once its last subtask is done (prepare -> SAT rows -> SAT columns -> detect),
+	// tiles without data (or of unsupported type) and cached tiles go from prepare directly to a detection
+	void executeTileTask(TileTaskContext& context, const TileTask& task, int threadNumber, SummedAreaTableTargetDetector* targetDetector)
 	{
-		const int guardRadius = (int)parameters["RmSAT-CFAR.guardRadius"];
-		const int clutterRadius = (int)parameters["RmSAT-CFAR.clutterRadius"];
-		const int windowRadius = (guardRadius + clutterRadius);
+		TileTaskScheduler& scheduler = *context.scheduler;
+		TileTaskState& state = context.tileStates[task.tileNumber];
+		const pair<int, int> tileIndex = context.tileIndices[task.tileNumber];
+		const Rect workingRect = context.tileManager->getTileWorkingRectangle(tileIndex);
+		const double startTime = omp_get_wtime();
 
-		return calculateBandSize(windowRadius);
+		switch (task.stage)
+		{
+		case StagePrepare: {
+			TileCacheEntry* cachedEntry = (context.cacheTileData ? tileCache.at(task.tileNumber) : NULL);
+			if (cachedEntry != NULL) {
+				state.tileCacheEntry = cachedEntry;
+				state.inputTile = cachedEntry->tile;
+			}
+			else {
+				// the arena stays with the tile until finishTile, other threads may still work on the previous tile of this thread
+				state.tileArena = (context.tileArenaPool != NULL ? context.tileArenaPool->acquire() : NULL);
+				targetDetector->setTileArena(state.tileArena);
+
+				// the censoring and histograms of the fit stage use the threads left over by the tiles, SATs and detection are split into tasks anyway
+				state.inputTile = createRayleighCompliantTile(context.tileManager->getInputTile(tileIndex), context.tileManager->getNoDataPixelCount(tileIndex), state.tileArena,
+					context.fitThreadCount);
+				targetDetector->setNoDataPixelCount(context.tileManager->getNoDataPixelCount(tileIndex));
+				double acceptedSeedError;
+				const vector<double> mixtureSeed = getMixtureSeed(*context.mixtureSeeding, task.tileNumber, acceptedSeedError);
+				targetDetector->setMixtureSeed(mixtureSeed, acceptedSeedError);
+				targetDetector->setIntraTileThreadCount(context.fitThreadCount);
+				state.tileCacheEntry = targetDetector->prepareTile(state.inputTile, context.globalHistogram, true, scheduler.getThreadCount());
+				targetDetector->setIntraTileThreadCount(1);
+				targetDetector->setTileArena(NULL);
+				context.mixtureSeeding->solutions[task.tileNumber] = targetDetector->getMixtureSolution();
+				context.mixtureSeeding->errors[task.tileNumber] = targetDetector->getMixtureError();
+
+				if (context.cacheTileData) {
+					tileCache.at(task.tileNumber) = state.tileCacheEntry;
+				}
+			}
+
+			// the solution is complete, so the fits seeded by it (and by no tile still being fitted) can start
+			const vector<int>& seededTiles = context.mixtureSeeding->seededTiles[task.tileNumber];
+			for (int k = 0; k < seededTiles.size(); k++) {
+				if (scheduler.completeSubtask(context.mixtureSeeding->remainingSeedCounts[seededTiles[k]])) {
+					scheduler.pushShared(TileTask(StagePrepare, seededTiles[k]));
+				}
+			}
+
+			// the bands of the tile are written in place into the result image, sparse outputs need a tile buffer
+			state.resultTile = context.tileManager->getResultTile(tileIndex);
+			if (state.resultTile.empty()) {
+				state.resultTile = Mat(state.inputTile.rows, state.inputTile.cols, context.resultType);
+			}
+
+			if (cachedEntry == NULL && state.tileCacheEntry != NULL && state.tileCacheEntry->containsData()) {
+				pushSubtasks(context, task.tileNumber, StageIntegralImageRows, (state.inputTile.rows + context.bandHeight - 1) / context.bandHeight, threadNumber);
+			}
+			else {
+				pushDetectionTasks(context, task.tileNumber, threadNumber);
+			}
+			break;
+		}
+
+		case StageIntegralImageRows: {
+			const int y1 = task.part * context.bandHeight;
+			state.tileCacheEntry->buildIntegralImageRows(y1, min(y1 + context.bandHeight, state.inputTile.rows));
+
+			if (scheduler.completeSubtask(state.remainingSubtaskCount)) {
+				pushSubtasks(context, task.tileNumber, StageIntegralImageColumns, state.tileCacheEntry->getIntegralImageColumnStripCount(), threadNumber);
+			}
+			break;
+		}
+
+		case StageIntegralImageColumns: {
+			state.tileCacheEntry->buildIntegralImageColumnStrip(task.part);
+
+			if (scheduler.completeSubtask(state.remainingSubtaskCount)) {
+				pushDetectionTasks(context, task.tileNumber, threadNumber);
+			}
+			break;
+		}
+
+		case StageDetect: {
+			// a tile without fit is filled as a whole by a single task
+			Rect bandRect = workingRect;
+			if (state.tileCacheEntry != NULL && state.tileCacheEntry->containsData()) {
+				bandRect.y = workingRect.y + task.part * context.bandHeight;
+				bandRect.height = min(context.bandHeight, workingRect.y + workingRect.height - bandRect.y);
+			}
+
+			TileCacheEntry** tileCacheEntry = (state.tileCacheEntry != NULL ? &state.tileCacheEntry : NULL);
+
+			if (context.isProbabilityMap)
+				targetDetector->executeProbabilityMap(state.inputTile, state.resultTile, context.globalHistogram, bandRect, tileCacheEntry);
+			else if (context.threadDetections != NULL) {
+				vector<TargetDetection>& tileDetections = context.threadDetections->at(threadNumber);
+				const size_t firstDetection = tileDetections.size();
+				targetDetector->executeDetectionList(state.inputTile, state.resultTile, context.globalHistogram, context.probabilityOfFalseAlarm, tileDetections, bandRect, tileCacheEntry);
+
+				moveDetectionsToImage(tileDetections, firstDetection, context.tileManager->getInputTileOrigin(tileIndex), context.image);
+			}
+			else
+				targetDetector->execute(state.inputTile, state.resultTile, context.globalHistogram, context.probabilityOfFalseAlarm, bandRect, tileCacheEntry);
+
+			if (scheduler.completeSubtask(state.remainingSubtaskCount)) {
+				finishTile(context, task.tileNumber);
+			}
+			break;
+		}
+		}
+
+		if (!context.tileTimes.empty()) {
+			const double taskTime = omp_get_wtime() - startTime;
+
+			#pragma omp atomic
+			context.tileTimes[task.tileNumber] += taskTime;
+		}
 	}
 
-	virtual bool isDeterministic() const { return false; }
+	void pushSubtasks(TileTaskContext& context, int tileNumber, TileTaskStage stage, int subtaskCount, int threadNumber)
+	{
+		context.tileStates[tileNumber].remainingSubtaskCount = subtaskCount;
 
-	virtual bool requiresGlobalHistogram() const { return true; }
+		// pushed in reverse, so the own thread continues with the first band
+		for (int part = subtaskCount - 1; part >= 0; part--) {
+			context.scheduler->push(threadNumber, TileTask(stage, tileNumber, part));
+		}
+	}
 
-private:
+	void pushDetectionTasks(TileTaskContext& context, int tileNumber, int threadNumber)
+	{
+		TileTaskState& state = context.tileStates[tileNumber];
+		const Rect workingRect = context.tileManager->getTileWorkingRectangle(context.tileIndices[tileNumber]);
+		const bool isBanded = (state.tileCacheEntry != NULL && state.tileCacheEntry->containsData());
+
+		pushSubtasks(context, tileNumber, StageDetect, (isBanded ? (workingRect.height + context.bandHeight - 1) / context.bandHeight : 1), threadNumber);
+	}
+
+	// the whole result tile is available, so it is labelled before the tile data is released
+	void finishTile(TileTaskContext& context, int tileNumber)
+	{
+		TileTaskState& state = context.tileStates[tileNumber];
+		const pair<int, int> tileIndex = context.tileIndices[tileNumber];
+
+		if (context.tileBlobs != NULL) {
+			TileBlobs& tileBlobs = context.tileBlobs->at(tileNumber);
+			Mat valueTile = context.tileManager->getInputTile(tileIndex);
+			TargetBlobExtractor::labelTile(state.resultTile, valueTile, context.tileManager->getTileWorkingRectangle(tileIndex), tileBlobs);
+
+			if (state.tileCacheEntry != NULL) {
+				for (int i = 0; i < tileBlobs.blobs.size(); i++) {
+					TargetBlob& blob = tileBlobs.blobs[i];
+					blob.clutterSigma = state.tileCacheEntry->calculateClutterSigma(context.guardRadius, context.windowRadius, blob.peakPosition.x, blob.peakPosition.y);
+				}
+			}
+
+			TargetBlobExtractor::translate(tileBlobs, context.tileManager->getInputTileOrigin(tileIndex));
+		}
+
+		if (!context.cacheTileData) {
+			delete state.tileCacheEntry;
+		}
+		state.tileCacheEntry = NULL;
+		state.inputTile = Mat();
+		state.resultTile = Mat();
+
+		if (state.tileArena != NULL) {
+			context.tileArenaPool->release(state.tileArena);
+			state.tileArena = NULL;
+		}
+	}
+
+	// predicted against measured tile costs, for tuning the cost model (the correlation is what matters for the ordering)
+	static void printTileCosts(const vector<pair<int, int>>& tileIndices, const vector<TileCostEstimate>& costEstimates, const vector<double>& tileTimes)
+	{
+		double sumCost = 0.0, sumTime = 0.0, sumCostCost = 0.0, sumTimeTime = 0.0, sumCostTime = 0.0;
+
+		cout << "Tile costs (tile : valid pixels, spread, predicted mixtures, predicted cost, measured ms)" << endl;
+		for (int i = 0; i < tileIndices.size(); i++) {
+			const TileCostEstimate& costEstimate = costEstimates[i];
+			const double tileTime = tileTimes[i] * 1000.0;
+
+			cout << "  " << tileIndices[i].first << "," << tileIndices[i].second << " : " << costEstimate.validPixelCount << ", " << costEstimate.spread << ", "
+				<< costEstimate.predictedMixtureCount << ", " << costEstimate.cost << ", " << tileTime << endl;
+
+			sumCost += costEstimate.cost;
+			sumTime += tileTime;
+			sumCostCost += costEstimate.cost * costEstimate.cost;
+			sumTimeTime += tileTime * tileTime;
+			sumCostTime += costEstimate.cost * tileTime;
+		}
 
-	static Mat createRayleighCompliantTile(Mat& tile)
+		const double n = (double)tileIndices.size();
+		const double covariance = n * sumCostTime - sumCost * sumTime;
+		const double deviationProduct = sqrt(max(n * sumCostCost - sumCost * sumCost, 0.0) * max(n * sumTimeTime - sumTime * sumTime, 0.0));
+
+		cout << "Tile cost correlation : " << (deviationProduct > 0.0 ? covariance / deviationProduct : 0.0) << endl;
+	}
+
+	// working memory of the largest tile : refined and median filtered tile, censor map, interval membership and double precision SATs
+	static size_t estimateTileArenaSize(Mat& image, Size tileSize, int bandSize, int maximumMixtureCount)
+	{
+		const size_t expandedWidth = min(tileSize.width + 2 * bandSize, image.cols);
+		const size_t expandedHeight = min(tileSize.height + 2 * bandSize, image.rows);
+		const size_t bytesPerPixel = 2 * image.elemSize() + 1 + (maximumMixtureCount <= 8 ? 1 : 4) + maximumMixtureCount * (sizeof(double) + sizeof(int));
+
+		return (expandedWidth * expandedHeight * bytesPerPixel + 64 * 1024);
+	}
+
+	// detections of a tile are in refined tile coordinates and values
+	static void moveDetectionsToImage(vector<TargetDetection>& detections, size_t firstDetection, Point tileOrigin, Mat& image)
+	{
+		for (size_t i = firstDetection; i < detections.size(); i++) {
+			TargetDetection& detection = detections[i];
+			detection.x += tileOrigin.x;
+			detection.y += tileOrigin.y;
+			detection.value = TargetDetectionList::getPixelValue(image, detection.x, detection.y);
+		}
+	}
+
+	bool isCacheValid(Mat& image, map<string, double>& parameters, int tileCount) const
+	{
+		return (!tileCache.empty() && tileCache.size() == tileCount && cachedImage.data == image.data && cachedImage.rows == image.rows && cachedImage.cols == image.cols
+			&& cachedImage.type() == image.type() && cachedImage.step == image.step && removeDetectionParameters(cachedParameters) == removeDetectionParameters(parameters));
+	}
+
+	// parameters that only affect the detection pass, so they do not invalidate the cached fits and SATs
+	static map<string, double> removeDetectionParameters(const map<string, double>& parameters)
 	{
-		Mat refinedTile(tile.rows, tile.cols, tile.type());
+		map<string, double> fittingParameters = parameters;
+		fittingParameters.erase("RmSAT-CFAR.vectorizedDetection");
+		fittingParameters.erase("RmSAT-CFAR.exponentialRelativeError");
+		fittingParameters.erase("RmSAT-CFAR.prescreening");
+		fittingParameters.erase("RmSAT-CFAR.taskScheduling");
+		fittingParameters.erase("RmSAT-CFAR.tileOrdering");
+		fittingParameters.erase("RmSAT-CFAR.logTileCosts");
+		fittingParameters.erase("RmSAT-CFAR.tileArena");
+		fittingParameters.erase("RmSAT-CFAR.largePages");
+
+		return fittingParameters;
+	}
+
+	// noDataPixelCount : zero pixels the tile was cropped by, they take part in the background percentile as in the full tile
+	static Mat createRayleighCompliantTile(Mat& tile, int noDataPixelCount = 0, TileArena* tileArena = NULL, int threadCount = 1)
+	{
+		Mat refinedTile = TileArena::allocate(tileArena, tile.rows, tile.cols, tile.type());
 
 		switch (tile.type())
 		{
-		case CV_8U:  createRayleighCompliantTile<unsigned char>(tile, refinedTile);		break;
-		case CV_8S:  createRayleighCompliantTile<char>(tile, refinedTile);				break;
-		case CV_16U: createRayleighCompliantTile<unsigned short>(tile, refinedTile);	break;
-		case CV_16S: createRayleighCompliantTile<short>(tile, refinedTile);				break;
-		case CV_32S: createRayleighCompliantTile<int>(tile, refinedTile);				break;
+		case CV_8U:  createRayleighCompliantTile<unsigned char>(tile, refinedTile, noDataPixelCount, threadCount);		break;
+		case CV_8S:  createRayleighCompliantTile<char>(tile, refinedTile, noDataPixelCount, threadCount);				break;
+		case CV_16U: createRayleighCompliantTile<unsigned short>(tile, refinedTile, noDataPixelCount, threadCount);	break;
+		case CV_16S: createRayleighCompliantTile<short>(tile, refinedTile, noDataPixelCount, threadCount);				break;
+		case CV_32S: createRayleighCompliantTile<int>(tile, refinedTile, noDataPixelCount, threadCount);				break;
 		default: refinedTile = tile.clone();
 		}
 
@@ -125,14 +842,19 @@ private:
 	}
 
 	template<typename T>
-	static void createRayleighCompliantTile(Mat& tile, Mat& refinedTile)
+	static void createRayleighCompliantTile(Mat& tile, Mat& refinedTile, int noDataPixelCount, int threadCount)
 	{
-		Mat tileHistogram = ImageUtilities::createHistogram(tile);
+		Mat tileHistogram = ImageUtilities::createHistogram(tile, 0, threadCount);
+		if (noDataPixelCount > 0 && tileHistogram.cols > 1) {
+			tileHistogram.at<int>(0) += noDataPixelCount;
+		}
 
 		const double backgroundStartPercentile = 0.005;
 		const double backgroundStart = ImageUtilities::getPercentileIndex<int>(tileHistogram, backgroundStartPercentile);
 
-		for (int y = 0; y < tile.rows; y++) {
+		int y;
+		#pragma omp parallel for num_threads(max(threadCount, 1)) if (threadCount > 1) schedule(static)
+		for (y = 0; y < tile.rows; y++) {
 			T* irow = (T*)(tile.data + y * tile.step);
 			T* rirow = (T*)(refinedTile.data + y * refinedTile.step);
 
@@ -145,10 +867,81 @@ private:
 		}
 	}
 
-	static Mat createHistogram(Mat& image, int tileSize, int simultaneouslyExecutedTile)
+	// seed of a tile fit (see MixtureSeeding), seed tiles without a mixture are left out, an interpolation of anchors is taken without annealing if its
+	// cost is at most the largest anchor cost plus the margin (acceptedSeedError, -infinity for seeds that are always refined)
+	static vector<double> getMixtureSeed(const MixtureSeeding& mixtureSeeding, int tileNumber, double& acceptedSeedError)
 	{
-		const int gridXcount = (image.cols + tileSize - 1) / tileSize;
-		const int gridYcount = (image.rows + tileSize - 1) / tileSize;
+		const vector<int>& seedTiles = mixtureSeeding.seedTiles[tileNumber];
+		const vector<double>& seedWeights = mixtureSeeding.seedWeights[tileNumber];
+
+		vector<double> mixtureSeed;
+		double weightSum = 0.0;
+		double largestError = -numeric_limits<double>::infinity();
+		for (int j = 0; j < seedTiles.size(); j++) {
+			const vector<double>& solution = mixtureSeeding.solutions[seedTiles[j]];
+			if (solution.empty()) {
+				continue;
+			}
+
+			if (mixtureSeed.empty()) {
+				mixtureSeed.assign(solution.size(), 0.0);
+			}
+			for (int d = 0; d < solution.size(); d++) {
+				mixtureSeed[d] += seedWeights[j] * solution[d];
+			}
+			weightSum += seedWeights[j];
+			largestError = max(largestError, mixtureSeeding.errors[seedTiles[j]]);
+		}
+
+		acceptedSeedError = -numeric_limits<double>::infinity();
+		if (mixtureSeed.empty()) {
+			return mixtureSeeding.sceneSolution;
+		}
+
+		for (int d = 0; d < mixtureSeed.size(); d++) {
+			mixtureSeed[d] /= weightSum;
+		}
+		if (mixtureSeeding.isInterpolation) {
+			acceptedSeedError = largestError + mixtureSeeding.interpolationMargin;
+		}
+
+		return mixtureSeed;
+	}
+
+	// scene histogram as the tiles see it after createRayleighCompliantTile (shifted by the background start), cut after its last non-zero bin
+	static Mat createRayleighCompliantHistogram(Mat& histogram)
+	{
+		const double backgroundStartPercentile = 0.005;
+		const double backgroundStart = ImageUtilities::getPercentileIndex<int>(histogram, backgroundStartPercentile);
+
+		int* hist = (int*)histogram.data;
+		int binCount = 1;
+		for (int i = 0; i < histogram.cols; i++) {
+			if (hist[i] > 0 && i - backgroundStart > 1) {
+				binCount = (int)(i - backgroundStart + 1.0) + 1;
+			}
+		}
+
+		Mat refinedHistogram(1, binCount, CV_32SC1, Scalar(0));
+		int* rhist = (int*)refinedHistogram.data;
+		for (int i = 0; i < histogram.cols; i++) {
+			if (hist[i] > 0 && i - backgroundStart > 1) {
+				rhist[(int)(i - backgroundStart + 1.0)] += hist[i];
+			}
+		}
+
+		return refinedHistogram;
+	}
+
+	// if cellDataRectangles is given, the occupancy index of the tile cells is built along (see TileManager::setOccupancyIndex)
+	static Mat createHistogram(Mat& image, Size tileSize, int simultaneouslyExecutedTile, vector<Rect>* cellDataRectangles = NULL)
+	{
+		const int gridXcount = (image.cols + tileSize.width - 1) / tileSize.width;
+		const int gridYcount = (image.rows + tileSize.height - 1) / tileSize.height;
+
+		if (cellDataRectangles != NULL) {
+			cellDataRectangles->assign(gridXcount * gridYcount, Rect());
+		}
 
 		Mat histogram;
 
@@ -161,15 +954,19 @@ private:
 		{
 			#pragma omp for private(tile, x, y, x1, y1, x2, y2, i, hptr, phptr)
 			for (y = 0; y < gridYcount; y++) {
-				y1 = y * tileSize;
-				y2 = min(y1 + tileSize, image.rows);
+				y1 = y * tileSize.height;
+				y2 = min(y1 + tileSize.height, image.rows);
 
 				for (x = 0; x < gridXcount; x++) {
-					x1 = x * tileSize;
-					x2 = min(x1 + tileSize, image.cols);
+					x1 = x * tileSize.width;
+					x2 = min(x1 + tileSize.width, image.cols);
 
 					tile = image(Range(y1, y2), Range(x1, x2));
 					ImageUtilities::addToHistogram(tile, privateHistogram);
+
+					if (cellDataRectangles != NULL) {
+						cellDataRectangles->at(y * gridXcount + x) = TileManager::findDataRectangle(image, Rect(x1, y1, x2 - x1, y2 - y1));
+					}
 				}
 			}
 
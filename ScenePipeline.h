@@ -0,0 +1,196 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <opencv2\opencv.hpp>
+#include "targetDetectors\TargetDetectionList.h"
+
+using namespace cv;
+using namespace std;
+
+
+// one scene on its way through the pipeline, the image is released after the detection and the results after writing
+struct SceneJob {
+	string inputFileName;
+	string outputFileName;
+	Mat image;
+	Mat targetMap;
+	vector<TargetDetection> detections;
+	bool isDetectionList;
+
+	SceneJob(string inputFileName = "", string outputFileName = "")
+	{
+		this->inputFileName = inputFileName;
+		this->outputFileName = outputFileName;
+		this->isDetectionList = false;
+	}
+};
+
+// FIFO of a bounded length, push waits while the queue is full and pop while it is empty
+template<typename T>
+class BoundedQueue {
+public:
+	BoundedQueue(int capacity)
+	{
+		this->capacity = max(capacity, 1);
+		isClosed = false;
+	}
+
+	void push(const T& item)
+	{
+		unique_lock<mutex> lock(queueMutex);
+		notFull.wait(lock, [this] { return (int)items.size() < capacity; });
+
+		items.push_back(item);
+		notEmpty.notify_one();
+	}
+
+	// false once the queue is closed and drained
+	bool pop(T& item)
+	{
+		unique_lock<mutex> lock(queueMutex);
+		notEmpty.wait(lock, [this] { return !items.empty() || isClosed; });
+
+		if (items.empty()) {
+			return false;
+		}
+
+		item = items.front();
+		items.pop_front();
+		notFull.notify_one();
+
+		return true;
+	}
+
+	void close()
+	{
+		lock_guard<mutex> lock(queueMutex);
+		isClosed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	int capacity;
+	bool isClosed;
+	deque<T> items;
+	mutex queueMutex;
+	condition_variable notFull;
+	condition_variable notEmpty;
+};
+
+// Reads, detects and writes a list of scenes as a pipeline. Reader threads decode the next scenes while the calling thread runs the (OpenMP parallel)
+// detection of the current one and a writer thread encodes the finished ones, so the end-to-end time approaches the larger of I/O and detection time
+// instead of their sum. The queues bound the scenes held in memory to queueLength + readerCount decoded and queueLength detected scenes. OpenCV decodes
+// and encodes an image as a whole, so a single scene is not overlapped with its own detection.
+class ScenePipeline {
+public:
+	ScenePipeline(int readerCount = 1, int queueLength = 2)
+	{
+		this->readerCount = max(readerCount, 1);
+		this->queueLength = max(queueLength, 1);
+	}
+
+	// detect fills targetMap or, for detection list outputs (isDetectionList), detections of the scene
+	void run(vector<SceneJob>& scenes, function<void(SceneJob&)> detect)
+	{
+		BoundedQueue<SceneJob*> readQueue(queueLength);
+		BoundedQueue<SceneJob*> writeQueue(queueLength);
+
+		int nextScene = 0;
+		mutex sceneMutex;
+
+		vector<thread> readers;
+		for (int r = 0; r < min(readerCount, (int)scenes.size()); r++) {
+			readers.push_back(thread([&]() {
+				while (true) {
+					int i;
+					{
+						lock_guard<mutex> lock(sceneMutex);
+						i = nextScene++;
+					}
+					if (i >= scenes.size()) {
+						break;
+					}
+
+					readScene(scenes[i]);
+					readQueue.push(&scenes[i]);
+				}
+			}));
+		}
+
+		thread writer([&]() {
+			SceneJob* scene;
+			while (writeQueue.pop(scene)) {
+				writeScene(*scene);
+			}
+		});
+
+		for (int i = 0; i < scenes.size(); i++) {
+			SceneJob* scene;
+			readQueue.pop(scene);
+
+			detect(*scene);
+			scene->image = Mat();
+
+			writeQueue.push(scene);
+		}
+		writeQueue.close();
+
+		for (int r = 0; r < readers.size(); r++) {
+			readers[r].join();
+		}
+		writer.join();
+	}
+
+	static void readScene(SceneJob& scene)
+	{
+		scene.image = imread(scene.inputFileName, CV_LOAD_IMAGE_UNCHANGED);
+		scene.isDetectionList = TargetDetectionList::isDetectionListFile(scene.outputFileName);
+	}
+
+	static void writeScene(SceneJob& scene)
+	{
+		if (scene.isDetectionList) {
+			if (!TargetDetectionList::write(scene.outputFileName, scene.detections))
+				cout << "Detection list could not be written! (" << scene.outputFileName << ")" << endl;
+		}
+		else if (!scene.targetMap.empty()) {
+			imwrite(scene.outputFileName, scene.targetMap);
+		}
+
+		scene.targetMap = Mat();
+		scene.detections.clear();
+	}
+
+	// a scene list is a text file with one file name per line
+	static bool isSceneListFile(string fileName)
+	{
+		return (fileName.size() >= 4 && (fileName.substr(fileName.size() - 4) == ".txt" || fileName.substr(fileName.size() - 4) == ".TXT"));
+	}
+
+	static vector<string> readSceneList(string fileName)
+	{
+		vector<string> fileNames;
+
+		ifstream file(fileName);
+		string line;
+		while (getline(file, line)) {
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+			if (!line.empty()) {
+				fileNames.push_back(line);
+			}
+		}
+
+		return fileNames;
+	}
+
+private:
+	int readerCount;
+	int queueLength;
+};
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <deque>
+#include <opencv2\opencv.hpp>
+#include "ImageUtilities.h"
+#include "RayleighMixtureData.h"
+#include "DetermineMixtureParameters.h"
+#include "IntegralImageData.h"
+#include "FastTargetDetector.h"
+
+using namespace std;
+using namespace cv;
+
+
+// Push-based RmSAT-CFAR for line-by-line input (e.g. strips of arbitrary length coming from a SAR processor).
+// The Rayleigh mixture is fitted once on the first leadingRowCount rows, then every pushed row goes through
+// censoring, SAT row accumulation and detection. Only the last 2 * maximumWindowRadius + 1 SAT rows are kept
+// (wrapping unsigned sums, so that box sums stay exact however long the strip is) and target row y is emitted
+// as soon as row y + maximumWindowRadius + 2 is pushed (the extra 2 rows are for the 3x3 median and dilation).
+class StreamingRayleighMixtureSummedAreaTableCFAR {
+public:
+	StreamingRayleighMixtureSummedAreaTableCFAR(int columnCount, int imageType, double probabilityOfFalseAlarm, map<string, double>& parameters)
+	{
+		guardRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.guardRadius", 5);
+		const int clutterRadius = (int)getParameterValue(parameters, "RmSAT-CFAR.clutterRadius", 5);
+		maximumMixtureCount = (int)getParameterValue(parameters, "RmSAT-CFAR.maximumMixtureCount", 5);
+		minimumMixtureCount = min((int)getParameterValue(parameters, "RmSAT-CFAR.minimumMixtureCount", 1), maximumMixtureCount);
+		leadingRowCount = max((int)getParameterValue(parameters, "RmSAT-CFAR.leadingRowCount", 512), 1);
+
+		windowRadius = guardRadius + clutterRadius;
+		histogramSize = 250;
+
+		FastTargetDetector<unsigned char> fastTargetDetector;
+		maximumExpansion = fastTargetDetector.getMaximumExpansion();
+		maximumWindowRadius = (maximumExpansion - 1) * windowRadius;
+
+		this->columnCount = columnCount;
+		this->imageType = imageType;
+		this->probabilityOfFalseAlarm = probabilityOfFalseAlarm;
+
+		leadingBlock = Mat(leadingRowCount, columnCount, imageType);
+
+		pushedRowCount = 0;
+		processedRowCount = 0;
+		summedAreaTableRowCount = 0;
+		detectedRowCount = 0;
+		isFitted = false;
+		isFinished = false;
+		containsData = false;
+		backgroundStart = 0.0;
+
+		rayleighMixtureData = NULL;
+		intervalIndices = NULL;
+	}
+
+	virtual ~StreamingRayleighMixtureSummedAreaTableCFAR()
+	{
+		delete rayleighMixtureData;
+		delete[] intervalIndices;
+	}
+
+	// row : 1 x columnCount image row of imageType
+	void pushRow(Mat& row)
+	{
+		if (isFinished || row.rows != 1 || row.cols != columnCount || row.type() != imageType) {
+			return;
+		}
+
+		switch (imageType)
+		{
+		case CV_8U:  pushRow<unsigned char>(row);		break;
+		case CV_8S:  pushRow<char>(row);				break;
+		case CV_16U: pushRow<unsigned short>(row);		break;
+		case CV_16S: pushRow<short>(row);				break;
+		case CV_32S: pushRow<int>(row);					break;
+		}
+	}
+
+	// flushes the remaining rows, the last row pushed is the bottom border of the image
+	void finish()
+	{
+		if (isFinished) {
+			return;
+		}
+
+		switch (imageType)
+		{
+		case CV_8U:  finish<unsigned char>();		break;
+		case CV_8S:  finish<char>();				break;
+		case CV_16U: finish<unsigned short>();		break;
+		case CV_16S: finish<short>();				break;
+		case CV_32S: finish<int>();					break;
+		}
+
+		isFinished = true;
+	}
+
+	// targetRow : 1 x columnCount CV_8UC1 target row, rowIndex : index of the row in the pushed order
+	bool popTargetRow(Mat& targetRow, int& rowIndex)
+	{
+		if (targetRows.empty()) {
+			return false;
+		}
+
+		rowIndex = targetRows.front().first;
+		targetRow = targetRows.front().second;
+		targetRows.pop_front();
+
+		return true;
+	}
+
+	int getPushedRowCount() const
+	{
+		return pushedRowCount;
+	}
+
+	int getDetectedRowCount() const
+	{
+		return detectedRowCount;
+	}
+
+	// number of rows a target row waits for after the mixture is fitted
+	int getLatency() const
+	{
+		return maximumWindowRadius + 2;
+	}
+
+	int getMaximumWindowRadius() const
+	{
+		return maximumWindowRadius;
+	}
+
+	// fitted mixture (NULL before the leading block is complete or if it does not contain any data pixel)
+	RayleighMixtureData* getRayleighMixtureData() const
+	{
+		return rayleighMixtureData;
+	}
+
+private:
+	int columnCount;
+	int imageType;
+	double probabilityOfFalseAlarm;
+
+	int guardRadius;
+	int windowRadius;
+	int minimumMixtureCount;
+	int maximumMixtureCount;
+	int histogramSize;
+	int maximumExpansion;
+	int maximumWindowRadius;
+	int leadingRowCount;
+
+	int pushedRowCount;
+	int processedRowCount;
+	int summedAreaTableRowCount;
+	int detectedRowCount;
+	bool isFitted;
+	bool isFinished;
+	bool containsData;
+
+	Mat leadingBlock;
+	double backgroundStart;
+
+	RayleighMixtureData* rayleighMixtureData;
+	int* intervalIndices;
+	Mat intervalMembershipTable;
+	DetectionKernelParameters kernelParameters;
+
+	// ring buffers indexed by row % ring size
+	Mat imageRing;
+	Mat censorRing;
+	int rowLength;
+	vector<unsigned long long> I2ring;
+	vector<unsigned int> Cring;
+
+	deque<pair<int, Mat>> targetRows;
+
+	struct RingRowAccessor {
+		StreamingRayleighMixtureSummedAreaTableCFAR* owner;
+
+		RingRowAccessor(StreamingRayleighMixtureSummedAreaTableCFAR* owner) : owner(owner)
+		{
+		}
+
+		inline void operator()(int y, unsigned long long*& I2row, unsigned int*& Crow) const
+		{
+			const int ringOffset = (y % (2 * owner->maximumWindowRadius + 1)) * owner->rowLength;
+
+			I2row = &owner->I2ring[ringOffset];
+			Crow = &owner->Cring[ringOffset];
+		}
+	};
+
+	template<typename T>
+	void pushRow(Mat& row)
+	{
+		pushedRowCount++;
+
+		if (!isFitted) {
+			Mat leadingRow = leadingBlock.row(pushedRowCount - 1);
+			row.copyTo(leadingRow);
+
+			if (pushedRowCount == leadingRowCount) {
+				fitMixture<T>(leadingRowCount);
+			}
+		}
+		else {
+			processRow<T>((T*)row.data);
+		}
+	}
+
+	template<typename T>
+	void finish()
+	{
+		if (!isFitted) {
+			if (pushedRowCount == 0) {
+				return;
+			}
+
+			fitMixture<T>(pushedRowCount);
+		}
+
+		if (!containsData) {
+			return;
+		}
+
+		// bottom border : the last row is its own lower neighbour for the median and has none for the dilation
+		const int height = processedRowCount;
+
+		createCensorRow<T>(height - 1, height - 1);
+
+		while (summedAreaTableRowCount < height) {
+			createSummedAreaTableRow<T>(summedAreaTableRowCount, height - 1);
+			detectRows<T>(summedAreaTableRowCount, false);
+		}
+
+		detectRows<T>(height, true);
+	}
+
+	template<typename T>
+	void fitMixture(int rowCount)
+	{
+		Mat block = leadingBlock(Range(0, rowCount), Range::all());
+
+		// background removal as in RayleighMixtureSummedAreaTableCFAR, with the leading block standing for the tile
+		Mat globalHistogram;
+		ImageUtilities::addToHistogram(block, globalHistogram);
+
+		Mat blockHistogram = ImageUtilities::createHistogram(block);
+
+		const double backgroundStartPercentile = 0.005;
+		backgroundStart = ImageUtilities::getPercentileIndex<int>(blockHistogram, backgroundStartPercentile);
+
+		Mat refinedBlock(block.rows, block.cols, block.type());
+		for (int y = 0; y < block.rows; y++) {
+			refineRow<T>((T*)(block.data + y * block.step), (T*)(refinedBlock.data + y * refinedBlock.step));
+
+			T* rrow = (T*)(refinedBlock.data + y * refinedBlock.step);
+			for (int x = 0; x < block.cols && !containsData; x++) {
+				containsData = (rrow[x] >= 1);
+			}
+		}
+
+		isFitted = true;
+
+		if (containsData) {
+			rayleighMixtureData = new RayleighMixtureData(refinedBlock, globalHistogram, histogramSize, maximumMixtureCount, probabilityOfFalseAlarm);
+			DetermineMixtureParameters::set<T>(*rayleighMixtureData, minimumMixtureCount);
+
+			const int intervalCount = rayleighMixtureData->intervalCount;
+			intervalIndices = IntegralImageData<T>::createIntervalIndices(rayleighMixtureData->histogram, intervalCount, rayleighMixtureData->intervals);
+			intervalMembershipTable = IntegralImageData<T>::createIntervalMembershipTable(intervalCount, intervalIndices);
+
+			// interleaved SAT layout
+			kernelParameters = FastTargetDetector<T>::createKernelParameters(*rayleighMixtureData, columnCount, intervalCount, 1, guardRadius, windowRadius, probabilityOfFalseAlarm);
+
+			rowLength = columnCount * intervalCount;
+			I2ring.assign((2 * maximumWindowRadius + 1) * rowLength, 0);
+			Cring.assign((2 * maximumWindowRadius + 1) * rowLength, 0);
+
+			imageRing = Mat(maximumWindowRadius + 3, columnCount, imageType);
+			censorRing = Mat(3, columnCount, CV_8UC1);
+
+			// the block itself is no longer needed by the mixture
+			rayleighMixtureData->image = Mat();
+			rayleighMixtureData->censorMap = Mat();
+		}
+
+		for (int y = 0; y < rowCount; y++) {
+			Mat row = block.row(y);
+			processRow<T>((T*)row.data);
+		}
+
+		leadingBlock = Mat();
+	}
+
+	template<typename T>
+	inline void refineRow(T* row, T* refinedRow)
+	{
+		for (int x = 0; x < columnCount; x++) {
+			if (row[x] - backgroundStart > 1)
+				refinedRow[x] = (T)(max(row[x] - backgroundStart, 0.0) + 1.0);
+			else
+				refinedRow[x] = 0;
+		}
+	}
+
+	// row y of the pushed image enters the pipeline : censoring of row y-1, SAT row y-2, detection of row y-2-maximumWindowRadius
+	template<typename T>
+	void processRow(T* row)
+	{
+		const int y = processedRowCount++;
+
+		if (!containsData) {
+			targetRows.push_back(pair<int, Mat>(y, Mat(1, columnCount, CV_8UC1, Scalar(0))));
+			detectedRowCount++;
+			return;
+		}
+
+		refineRow<T>(row, getImageRow<T>(y));
+
+		if (y >= 1) {
+			createCensorRow<T>(y - 1, y);
+		}
+
+		if (y >= 2) {
+			createSummedAreaTableRow<T>(y - 2, y - 1);
+			detectRows<T>(summedAreaTableRowCount, false);
+		}
+	}
+
+	template<typename T>
+	inline T* getImageRow(int y)
+	{
+		const int ringRow = y % imageRing.rows;
+		return (T*)(imageRing.data + ringRow * imageRing.step);
+	}
+
+	inline unsigned char* getCensorRow(int y)
+	{
+		const int ringRow = y % censorRing.rows;
+		return (unsigned char*)(censorRing.data + ringRow * censorRing.step);
+	}
+
+	// censoring before dilation (see RayleighMixtureData::createCensorMap), lastRowIndex is the last available image row
+	template<typename T>
+	void createCensorRow(int y, int lastRowIndex)
+	{
+		const double contrastThreshold = rayleighMixtureData->contrastThreshold;
+		const double reflectivityUpperBound = rayleighMixtureData->reflectivityUpperBound;
+
+		// 3x3 median with replicated borders
+		T* rows[3] = { getImageRow<T>(max(y - 1, 0)), getImageRow<T>(y), getImageRow<T>(min(y + 1, lastRowIndex)) };
+		unsigned char* crow = getCensorRow(y);
+
+		T* irow = rows[1];
+		T p[9];
+		for (int x = 0; x < columnCount; x++) {
+			const int xl = max(x - 1, 0);
+			const int xr = min(x + 1, columnCount - 1);
+
+			for (int k = 0; k < 3; k++) {
+				p[3 * k] = rows[k][xl];
+				p[3 * k + 1] = rows[k][x];
+				p[3 * k + 2] = rows[k][xr];
+			}
+
+			const T median = median9<T>(p);
+
+			crow[x] = (irow[x] > reflectivityUpperBound || irow[x] - median > contrastThreshold ? UCHAR_MAX : 0);
+		}
+	}
+
+	// 3x3 median by a 19 comparison sorting network
+	template<typename T>
+	static inline T median9(T* p)
+	{
+		sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+		sort2(p[0], p[1]); sort2(p[3], p[4]); sort2(p[6], p[7]);
+		sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+		sort2(p[0], p[3]); sort2(p[5], p[8]); sort2(p[4], p[7]);
+		sort2(p[3], p[6]); sort2(p[1], p[4]); sort2(p[2], p[5]);
+		sort2(p[4], p[7]); sort2(p[4], p[2]); sort2(p[6], p[4]);
+		sort2(p[4], p[2]);
+
+		return p[4];
+	}
+
+	template<typename T>
+	static inline void sort2(T& a, T& b)
+	{
+		if (a > b) {
+			const T t = a;
+			a = b;
+			b = t;
+		}
+	}
+
+	// SAT row y from the image row and the dilated censoring (3x3 ellipse is a cross), lastCensorRowIndex is the last censored row available
+	template<typename T>
+	void createSummedAreaTableRow(int y, int lastCensorRowIndex)
+	{
+		T* imageRow = getImageRow<T>(y);
+		unsigned char* censorRow = getCensorRow(y);
+		unsigned char* censorRowUp = (y > 0 ? getCensorRow(y - 1) : NULL);
+		unsigned char* censorRowDown = (y < lastCensorRowIndex ? getCensorRow(y + 1) : NULL);
+
+		RingRowAccessor satRow(this);
+		unsigned long long* I2row;
+		unsigned int* Crow;
+		satRow(y, I2row, Crow);
+
+		const int intervalCount = rayleighMixtureData->intervalCount;
+		const unsigned int* membershipTable = (unsigned int*)intervalMembershipTable.data;
+		const int membershipTableSize = intervalMembershipTable.cols;
+
+		// row prefix sums
+		for (int x = 0; x < columnCount; x++) {
+			const bool isCensored = (censorRow[x] != 0 || (x > 0 && censorRow[x - 1] != 0) || (x < columnCount - 1 && censorRow[x + 1] != 0)
+				|| (censorRowUp != NULL && censorRowUp[x] != 0) || (censorRowDown != NULL && censorRowDown[x] != 0));
+
+			const bool isNotCensored = (imageRow[x] > 0 && !isCensored);
+			const int tableIndex = (isNotCensored ? (int)imageRow[x] : 0);
+			const unsigned int membership = (isNotCensored && tableIndex < membershipTableSize ? membershipTable[tableIndex] : 0);
+
+			const int xShifted = x * intervalCount;
+			const int xShiftedLeft = xShifted - intervalCount;
+
+			for (int intervalIndex = 0; intervalIndex < intervalCount; intervalIndex++) {
+				I2row[xShifted + intervalIndex] = (x > 0 ? I2row[xShiftedLeft + intervalIndex] : 0);
+				Crow[xShifted + intervalIndex] = (x > 0 ? Crow[xShiftedLeft + intervalIndex] : 0);
+			}
+
+			if (membership != 0) {
+				const unsigned long long pixelvalueSqr = (unsigned long long)tableIndex * tableIndex;
+
+				int intervalShift = xShifted;
+				for (unsigned int bits = membership; bits != 0; bits >>= 1) {
+					if (bits & 1) {
+						I2row[intervalShift] += pixelvalueSqr;
+						Crow[intervalShift] += 1;
+					}
+
+					intervalShift++;
+				}
+			}
+		}
+
+		// column accumulation
+		if (y > 0) {
+			unsigned long long* I2rowUp;
+			unsigned int* CrowUp;
+			satRow(y - 1, I2rowUp, CrowUp);
+
+			for (int x = 0; x < rowLength; x++) {
+				I2row[x] += I2rowUp[x];
+			}
+
+			for (int x = 0; x < rowLength; x++) {
+				Crow[x] += CrowUp[x];
+			}
+		}
+
+		summedAreaTableRowCount++;
+	}
+
+	// detects the rows whose largest window is complete, at the end of the image (isLastRows) all remaining rows are detected
+	template<typename T>
+	void detectRows(int height, bool isLastRows)
+	{
+		FastTargetDetector<T> fastTargetDetector(maximumExpansion);
+		vector<SummedAreaTableRows<unsigned long long, unsigned int>> satRows(maximumExpansion);
+		RingRowAccessor satRow(this);
+
+		int targetCount = 0;
+		int expansionCount = 0;
+
+		while (detectedRowCount < height && (isLastRows || detectedRowCount + maximumWindowRadius < height)) {
+			const int y = detectedRowCount;
+
+			for (int expansion = 1; expansion < maximumExpansion; expansion++) {
+				FastTargetDetector<T>::determineRowPointers(guardRadius, expansion * windowRadius, height, y, satRow, satRows[expansion]);
+			}
+
+			Mat targetRow(1, columnCount, CV_8UC1);
+			fastTargetDetector.template detectRow<unsigned long long, unsigned int>(kernelParameters, getImageRow<T>(y), targetRow.data, 0, columnCount, &satRows[0], targetCount, expansionCount);
+
+			targetRows.push_back(pair<int, Mat>(y, targetRow));
+			detectedRowCount++;
+		}
+	}
+
+	static double getParameterValue(map<string, double>& parameters, string key, double defaultValue)
+	{
+		if (parameters.find(key) == parameters.end())
+			return defaultValue;
+		else
+			return parameters[key];
+	}
+
+};
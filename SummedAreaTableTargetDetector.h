@@ -5,14 +5,97 @@
 #include "AdaptiveSimulatedAnnealing.h"
 #include "RayleighMixtureData.h"
 #include "DetermineMixtureParameters.h"
+#include "MixtureFitCache.h"
 #include "IntegralImageData.h"
 #include "FastTargetDetector.h"
+#include "TargetBlobExtractor.h"
 #include "TargetDetectorBaseLogger.h"
 
 using namespace std;
 using namespace cv;
 
 
+// intermediates of a tile that do not depend on the probability of false alarm (refined tile, censoring, mixture fit and SATs)
+class TileCacheEntry {
+public:
+	Mat tile;
+
+	virtual ~TileCacheEntry()
+	{
+	}
+
+	virtual bool containsData() const
+	{
+		return false;
+	}
+
+	// stages of deferred SAT construction (see SummedAreaTableTargetDetector::prepareTile)
+	virtual void buildIntegralImageRows(int y1, int y2)
+	{
+	}
+
+	virtual int getIntegralImageColumnStripCount() const
+	{
+		return 0;
+	}
+
+	virtual void buildIntegralImageColumnStrip(int strip)
+	{
+	}
+
+	virtual double calculateClutterSigma(int guardRadius, int windowRadius, int x, int y)
+	{
+		return 0.0;
+	}
+};
+
+template<typename T>
+class TypedTileCacheEntry : public TileCacheEntry {
+public:
+	// both are NULL if the tile does not contain any data pixel
+	RayleighMixtureData* rayleighMixtureData;
+	IntegralImageData<T>* integralImageData;
+
+	TypedTileCacheEntry(Mat& tile, RayleighMixtureData* rayleighMixtureData, IntegralImageData<T>* integralImageData)
+	{
+		this->tile = tile;
+		this->rayleighMixtureData = rayleighMixtureData;
+		this->integralImageData = integralImageData;
+	}
+
+	virtual ~TypedTileCacheEntry()
+	{
+		delete integralImageData;
+		delete rayleighMixtureData;
+	}
+
+	virtual bool containsData() const
+	{
+		return (rayleighMixtureData != NULL);
+	}
+
+	virtual void buildIntegralImageRows(int y1, int y2)
+	{
+		integralImageData->buildRowPrefixSums(y1, y2);
+	}
+
+	virtual int getIntegralImageColumnStripCount() const
+	{
+		return (integralImageData != NULL ? integralImageData->getColumnStripCount() : 0);
+	}
+
+	virtual void buildIntegralImageColumnStrip(int strip)
+	{
+		integralImageData->buildColumnStrip(strip);
+	}
+
+	virtual double calculateClutterSigma(int guardRadius, int windowRadius, int x, int y)
+	{
+		FastTargetDetector<T> fastTargetDetector;
+		return (rayleighMixtureData != NULL ? fastTargetDetector.calculateClutterSigma(*rayleighMixtureData, *integralImageData, guardRadius, windowRadius, x, y) : 0.0);
+	}
+};
+
 class SummedAreaTableTargetDetector {
 public:
 	SummedAreaTableTargetDetector(int minimumMixtureCount, int maximumMixtureCount, int guardRadius, int clutterRadius)
@@ -23,35 +106,71 @@ public:
 		this->windowRadius = guardRadius + clutterRadius;
 
 		histogramSize = 250;
+		integralImageLayout = LayoutInterleaved;
+		integralImageStorage = StorageDouble;
+		validateCompactStorage = false;
+		validationMismatchCount = 0;
+		intraTileThreadCount = 1;
+		vectorizedDetection = true;
+		exponentialTable = NULL;
+		prescreening = true;
+		noDataPixelCount = 0;
+		tileArena = NULL;
+		fitIterationCount = 0;
+		acceptedSeedError = -numeric_limits<double>::infinity();
+		acceptedSeedCount = 0;
+		mixtureError = 0.0;
+		mixtureFitCache = NULL;
 		_internalLogger = new TargetDetectorBaseLogger;
 		_logger = _internalLogger;
 	}
 
 	virtual ~SummedAreaTableTargetDetector()
 	{
+		delete exponentialTable;
 		delete _internalLogger;
 	}
 
-	void execute(Mat& image, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, Rect workingRect = Rect())
+	// if tileCacheEntry is given, an existing entry is reused (only the target detection is done) and a missing one is created and returned
+	void execute(Mat& image, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, Rect workingRect = Rect(), TileCacheEntry** tileCacheEntry = NULL)
 	{
-		if (workingRect.width == 0 || workingRect.height == 0) {
-			workingRect.x = 0;
-			workingRect.y = 0;
-			workingRect.width = image.cols;
-			workingRect.height = image.rows;
-		}
+		executeTile(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, false, NULL, NULL, NULL);
+	}
+
+	// as execute, the target pixels of workingRect are also appended to detections (tile coordinates, with their false alarm probability)
+	void executeDetectionList(Mat& image, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, vector<TargetDetection>& detections, Rect workingRect = Rect(), TileCacheEntry** tileCacheEntry = NULL)
+	{
+		executeTile(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, false, &detections, NULL, NULL);
+	}
+
+	// as execute, the target pixels of workingRect are also labelled into blobs (tile coordinates), blob intensities are taken from valueImage
+	// (same geometry as image, e.g. the tile before refinement) and the clutter sigma of each blob from the SATs at its peak
+	void executeBlobs(Mat& image, Mat& valueImage, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, TileBlobs& tileBlobs, Rect workingRect = Rect(), TileCacheEntry** tileCacheEntry = NULL)
+	{
+		executeTile(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, false, NULL, &tileBlobs, &valueImage);
+	}
 
+	// censoring and mixture fit of a tile (NULL if the tile type is not supported), with deferredIntegralImages the SATs are only allocated and are built
+	// by the caller through the entry (all rows, then all column strips) before the entry is passed to execute, otherwise the entry is complete
+	TileCacheEntry* prepareTile(Mat& image, Mat& globalHistogram, bool deferredIntegralImages, int columnStripThreadCount = 1)
+	{
 		switch (image.type())
 		{
-		case CV_8U:  detectTargets<unsigned char>(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect);		break;
-		case CV_8S:  detectTargets<char>(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect);				break;
-		case CV_16U: detectTargets<unsigned short>(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect);	break;
-		case CV_16S: detectTargets<short>(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect);				break;
-		case CV_32S: detectTargets<int>(image, targetMap, globalHistogram, probabilityOfFalseAlarm, workingRect);				break;
-		default: targetMap = Scalar(0);
+		case CV_8U:  return createTileCacheEntry<unsigned char>(image, globalHistogram, 1.0, deferredIntegralImages, columnStripThreadCount);
+		case CV_8S:  return createTileCacheEntry<char>(image, globalHistogram, 1.0, deferredIntegralImages, columnStripThreadCount);
+		case CV_16U: return createTileCacheEntry<unsigned short>(image, globalHistogram, 1.0, deferredIntegralImages, columnStripThreadCount);
+		case CV_16S: return createTileCacheEntry<short>(image, globalHistogram, 1.0, deferredIntegralImages, columnStripThreadCount);
+		case CV_32S: return createTileCacheEntry<int>(image, globalHistogram, 1.0, deferredIntegralImages, columnStripThreadCount);
+		default: return NULL;
 		}
 	}
 
+	// per-pixel false alarm probability of the tile (probabilityMap : CV_32F), a pixel is a target at Pfa if its probability is below Pfa
+	void executeProbabilityMap(Mat& image, Mat& probabilityMap, Mat& globalHistogram, Rect workingRect = Rect(), TileCacheEntry** tileCacheEntry = NULL)
+	{
+		executeTile(image, probabilityMap, globalHistogram, 1.0, workingRect, tileCacheEntry, true, NULL, NULL, NULL);
+	}
+
 	void setLogger(TargetDetectorBaseLogger* logger)
 	{
 		this->_logger = logger;
@@ -72,40 +191,273 @@ public:
 		return histogramSize;
 	}
 
+	void setIntegralImageLayout(IntegralImageLayout integralImageLayout)
+	{
+		this->integralImageLayout = integralImageLayout;
+	}
+
+	IntegralImageLayout getIntegralImageLayout() const
+	{
+		return integralImageLayout;
+	}
+
+	void setIntegralImageStorage(IntegralImageStorage integralImageStorage)
+	{
+		this->integralImageStorage = integralImageStorage;
+	}
+
+	IntegralImageStorage getIntegralImageStorage() const
+	{
+		return integralImageStorage;
+	}
+
+	// if set, each tile detected with compact SAT storage is also detected with double precision SATs and the differing decisions are counted
+	void setValidateCompactStorage(bool validateCompactStorage)
+	{
+		this->validateCompactStorage = validateCompactStorage;
+	}
+
+	long long getValidationMismatchCount() const
+	{
+		return validationMismatchCount;
+	}
+
+	// number of threads used inside a single tile (e.g. when there are fewer tiles than cores)
+	void setIntraTileThreadCount(int intraTileThreadCount)
+	{
+		this->intraTileThreadCount = max(intraTileThreadCount, 1);
+	}
+
+	int getIntraTileThreadCount() const
+	{
+		return intraTileThreadCount;
+	}
+
+	// use the vectorized FastTargetDetector kernel if the CPU supports AVX2
+	void setVectorizedDetection(bool vectorizedDetection)
+	{
+		this->vectorizedDetection = vectorizedDetection;
+	}
+
+	bool getVectorizedDetection() const
+	{
+		return vectorizedDetection;
+	}
+
+	// if positive, Rayleigh tail probabilities are evaluated by a table with this relative error bound instead of exp
+	void setExponentialRelativeError(double exponentialRelativeError)
+	{
+		delete exponentialTable;
+		exponentialTable = (exponentialRelativeError > 0.0 ? new ExponentialTable(exponentialRelativeError) : NULL);
+	}
+
+	double getExponentialRelativeError() const
+	{
+		return (exponentialTable != NULL ? exponentialTable->getMaximumRelativeError() : 0.0);
+	}
+
+	// skip the SAT queries of pixels that are below a conservative target threshold of their block (results are unchanged)
+	void setPrescreening(bool prescreening)
+	{
+		this->prescreening = prescreening;
+	}
+
+	bool getPrescreening() const
+	{
+		return prescreening;
+	}
+
+	// zero pixels the next tiles were cropped by (see TileManager::setOccupancyIndex), they take part in the censoring threshold as in the full tile
+	void setNoDataPixelCount(int noDataPixelCount)
+	{
+		this->noDataPixelCount = noDataPixelCount;
+	}
+
+	// working memory of the next tiles (not owned), the caller resets it once the tile data is released, NULL allocates from the heap
+	void setTileArena(TileArena* tileArena)
+	{
+		this->tileArena = tileArena;
+	}
+
+	// annealing variables the mixture fit of the next tiles starts from (see DetermineMixtureParameters::set), empty for the default start,
+	// the seed is taken without annealing if its cost on the tile does not exceed acceptedSeedError (e.g. an interpolation of anchor fits),
+	// the solution of the previous fit is cleared
+	void setMixtureSeed(const vector<double>& mixtureSeed, double acceptedSeedError = -numeric_limits<double>::infinity())
+	{
+		this->mixtureSeed = mixtureSeed;
+		this->acceptedSeedError = acceptedSeedError;
+		mixtureSolution.clear();
+	}
+
+	// annealing variables of the last mixture fit (empty if the tile had no data or was taken from the cache)
+	const vector<double>& getMixtureSolution() const
+	{
+		return mixtureSolution;
+	}
+
+	// cost of the last mixture fit (see RayleighMixtureData::finalError)
+	double getMixtureError() const
+	{
+		return mixtureError;
+	}
+
+	// seeds taken without annealing
+	long long getAcceptedSeedCount() const
+	{
+		return acceptedSeedCount;
+	}
+
+	// fits of tiles with the same histogram signature are reused from the cache (not owned, shared by the detectors of an image), NULL fits every tile
+	void setMixtureFitCache(MixtureFitCache* mixtureFitCache)
+	{
+		this->mixtureFitCache = mixtureFitCache;
+	}
+
+	// annealing variables of the mixture of a histogram without image (e.g. the scene histogram), a seed of the tile fits
+	vector<double> fitHistogramMixture(Mat& histogram)
+	{
+		RayleighMixtureData rayleighMixtureData(histogram, histogramSize, dimension);
+		DetermineMixtureParameters::set<int>(rayleighMixtureData, minimumMixtureCount);
+		fitIterationCount += rayleighMixtureData.iterationCount;
+
+		return rayleighMixtureData.solution;
+	}
+
+	// annealing iterations of all mixture fits done by this detector
+	long long getFitIterationCount() const
+	{
+		return fitIterationCount;
+	}
+
 private:
 	int dimension;
 	int minimumMixtureCount;
 	int guardRadius;
 	int windowRadius;
 	int histogramSize;
+	IntegralImageLayout integralImageLayout;
+	IntegralImageStorage integralImageStorage;
+	bool validateCompactStorage;
+	long long validationMismatchCount;
+	int intraTileThreadCount;
+	bool vectorizedDetection;
+	ExponentialTable* exponentialTable;
+	bool prescreening;
+	int noDataPixelCount;
+	TileArena* tileArena;
+	vector<double> mixtureSeed;
+	vector<double> mixtureSolution;
+	long long fitIterationCount;
+	double acceptedSeedError;
+	long long acceptedSeedCount;
+	double mixtureError;
+	MixtureFitCache* mixtureFitCache;
 	
 	TargetDetectorBaseLogger* _logger;
 	TargetDetectorBaseLogger* _internalLogger;
 
+	void executeTile(Mat& image, Mat& resultMap, Mat& globalHistogram, double probabilityOfFalseAlarm, Rect workingRect, TileCacheEntry** tileCacheEntry, bool isProbabilityMap, vector<TargetDetection>* detections,
+		TileBlobs* tileBlobs, Mat* valueImage)
+	{
+		if (workingRect.width == 0 || workingRect.height == 0) {
+			workingRect.x = 0;
+			workingRect.y = 0;
+			workingRect.width = image.cols;
+			workingRect.height = image.rows;
+		}
+
+		switch (image.type())
+		{
+		case CV_8U:  detectTargets<unsigned char>(image, resultMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, isProbabilityMap, detections, tileBlobs, valueImage);	break;
+		case CV_8S:  detectTargets<char>(image, resultMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, isProbabilityMap, detections, tileBlobs, valueImage);			break;
+		case CV_16U: detectTargets<unsigned short>(image, resultMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, isProbabilityMap, detections, tileBlobs, valueImage);	break;
+		case CV_16S: detectTargets<short>(image, resultMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, isProbabilityMap, detections, tileBlobs, valueImage);			break;
+		case CV_32S: detectTargets<int>(image, resultMap, globalHistogram, probabilityOfFalseAlarm, workingRect, tileCacheEntry, isProbabilityMap, detections, tileBlobs, valueImage);			break;
+		default:
+			resultMap(workingRect).setTo(Scalar(isProbabilityMap ? 1.0 : 0.0));
+			if (tileBlobs != NULL) {
+				TargetBlobExtractor::labelTile(resultMap, *valueImage, workingRect, *tileBlobs);
+			}
+		}
+	}
+
+	// resultMap is the target map (CV_8U) or, if isProbabilityMap is set, the probability map (CV_32F), targets are also appended to detections
+	// and labelled into tileBlobs if they are given, only the working rectangle of resultMap is written
 	template<typename T>
-	void detectTargets(Mat& image, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, Rect workingRect)
+	void detectTargets(Mat& image, Mat& targetMap, Mat& globalHistogram, double probabilityOfFalseAlarm, Rect workingRect, TileCacheEntry** tileCacheEntry, bool isProbabilityMap,
+		vector<TargetDetection>* detections, TileBlobs* tileBlobs, Mat* valueImage)
 	{
 		_logger->startTotalTimer();
 
-		T startIndex = 1;
-		if (doesContainData<T>(image, startIndex)) {
-			_logger->startTimer();
-			RayleighMixtureData rayleighMixtureData(image, globalHistogram, histogramSize, dimension, probabilityOfFalseAlarm);
-			_logger->endTimer("RayleighMixtureData\t\t\t= ");
+		TypedTileCacheEntry<T>* typedTileCacheEntry = (tileCacheEntry != NULL ? dynamic_cast<TypedTileCacheEntry<T>*>(*tileCacheEntry) : NULL);
+		if (typedTileCacheEntry == NULL) {
+			typedTileCacheEntry = createTileCacheEntry<T>(image, globalHistogram, probabilityOfFalseAlarm, false, intraTileThreadCount);
+
+			if (tileCacheEntry != NULL) {
+				delete *tileCacheEntry;
+				*tileCacheEntry = typedTileCacheEntry;
+			}
+		}
+		else {
+			_logger->printText("Using cached mixture fit and SATs");
+		}
+
+		if (typedTileCacheEntry->rayleighMixtureData != NULL) {
+			RayleighMixtureData& rayleighMixtureData = *typedTileCacheEntry->rayleighMixtureData;
+			IntegralImageData<T>& integralImageData = *typedTileCacheEntry->integralImageData;
 
 			// uncomment to see created censor-map as a result image
 			///targetMap = rayleighMixtureData.censorMap;   return;
 
-			DetermineMixtureParameters::set<T>(rayleighMixtureData, minimumMixtureCount);
-			_logger->endTimer("DetermineMixtureParameters::set<T>\t= ");
+			_logger->startTimer();
+			FastTargetDetector<T> fastTargetDetector;
+			fastTargetDetector.setVectorization(vectorizedDetection);
+			fastTargetDetector.setExponentialTable(exponentialTable);
+			fastTargetDetector.setPrescreening(prescreening);
+			fastTargetDetector.setThreadCount(intraTileThreadCount);
 
-			IntegralImageData<T> integralImageData(rayleighMixtureData);
-			_logger->endTimer("IntegralImageData<T>\t\t\t= ");
+			if (isProbabilityMap) {
+				fastTargetDetector.executeProbabilityMap(rayleighMixtureData, integralImageData, guardRadius, windowRadius, targetMap, workingRect);
+				_logger->endTimer("FastTargetDetector<T> (probabilities)\t= ");
+				_logger->endTotalTimer("TOTAL TIME \t\t\t\t= ");
+
+				if (tileCacheEntry == NULL) {
+					delete typedTileCacheEntry;
+				}
+				return;
+			}
 
-			FastTargetDetector<T> fastTargetDetector;
 			TargetDetectionInformation targetDetectionInformation = fastTargetDetector.execute(rayleighMixtureData, integralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm, targetMap, workingRect);
 			_logger->endTimer("FastTargetDetector<T>\t\t\t= ");
 
+			if (detections != NULL) {
+				fastTargetDetector.appendDetections(rayleighMixtureData, integralImageData, guardRadius, windowRadius, targetMap, workingRect, *detections);
+			}
+
+			if (tileBlobs != NULL) {
+				TargetBlobExtractor::labelTile(targetMap, *valueImage, workingRect, *tileBlobs);
+
+				for (int i = 0; i < tileBlobs->blobs.size(); i++) {
+					TargetBlob& blob = tileBlobs->blobs[i];
+					blob.clutterSigma = fastTargetDetector.calculateClutterSigma(rayleighMixtureData, integralImageData, guardRadius, windowRadius, blob.peakPosition.x, blob.peakPosition.y);
+				}
+			}
+
+			if (validateCompactStorage && integralImageData.storage == StorageCompact) {
+				const int maximumWindowRadius = (fastTargetDetector.getMaximumExpansion() - 1) * windowRadius;
+				IntegralImageData<T> referenceIntegralImageData(rayleighMixtureData, integralImageLayout, StorageDouble, maximumWindowRadius, intraTileThreadCount);
+
+				Mat referenceTargetMap(targetMap.rows, targetMap.cols, CV_8UC1);
+				fastTargetDetector.execute(rayleighMixtureData, referenceIntegralImageData, guardRadius, windowRadius, probabilityOfFalseAlarm, referenceTargetMap, workingRect);
+
+				const int mismatchCount = countMismatches(targetMap, referenceTargetMap, workingRect);
+				validationMismatchCount += mismatchCount;
+
+				stringstream ss;
+				ss << "Compact SAT storage validation : " << mismatchCount << " decisions differ from double precision SATs";
+				_logger->printText(ss.str());
+			}
+
 			_logger->endTotalTimer("TOTAL TIME \t\t\t\t= ");
 
 			stringstream ss;
@@ -118,14 +470,98 @@ private:
 		else {
 			_logger->printText("Does not contain any data pixel!");
 
-			for (int y = 0; y < targetMap.rows; y++) {
-				unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+			// only the working rectangle, the target map may be a view of the result image shared with the neighbouring tiles
+			if (isProbabilityMap) {
+				targetMap(workingRect).setTo(Scalar(1.0));
+			}
+			else {
+				for (int y = workingRect.y; y < workingRect.y + workingRect.height; y++) {
+					unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+
+					for (int x = workingRect.x; x < workingRect.x + workingRect.width; x++) {
+						trow[x] = 0;
+					}
+				}
 
-				for (int x = 0; x < targetMap.cols; x++) {
-					trow[x] = 0;
+				if (tileBlobs != NULL) {
+					TargetBlobExtractor::labelTile(targetMap, *valueImage, workingRect, *tileBlobs);
 				}
 			}
 		}
+
+		if (tileCacheEntry == NULL) {
+			delete typedTileCacheEntry;
+		}
+	}
+
+	// censoring, mixture fit and SAT construction of a tile, none of them depends on the probability of false alarm
+	template<typename T>
+	TypedTileCacheEntry<T>* createTileCacheEntry(Mat& image, Mat& globalHistogram, double probabilityOfFalseAlarm, bool deferredIntegralImages, int threadCount)
+	{
+		T startIndex = 1;
+		if (!doesContainData<T>(image, startIndex)) {
+			return new TypedTileCacheEntry<T>(image, NULL, NULL);
+		}
+
+		_logger->startTimer();
+		RayleighMixtureData* rayleighMixtureData = new RayleighMixtureData(image, globalHistogram, histogramSize, dimension, probabilityOfFalseAlarm, noDataPixelCount, tileArena, intraTileThreadCount);
+		_logger->endTimer("RayleighMixtureData\t\t\t= ");
+
+		vector<int> fitSignature;
+		vector<double> cachedSolution;
+		if (mixtureFitCache != NULL && dimension > 1) {
+			fitSignature = mixtureFitCache->createSignature(*rayleighMixtureData);
+		}
+
+		// a cached solution that is not a valid mixture of this tile and a seed above the accepted cost are fitted anyway
+		bool isFitted = (!fitSignature.empty() && mixtureFitCache->find(fitSignature, cachedSolution)
+			&& DetermineMixtureParameters::apply<T>(*rayleighMixtureData, minimumMixtureCount, cachedSolution));
+
+		if (!isFitted && acceptedSeedError > -numeric_limits<double>::infinity()) {
+			isFitted = (DetermineMixtureParameters::apply<T>(*rayleighMixtureData, minimumMixtureCount, mixtureSeed) && rayleighMixtureData->finalError <= acceptedSeedError);
+			if (isFitted) {
+				acceptedSeedCount++;
+			}
+		}
+
+		if (!isFitted) {
+			DetermineMixtureParameters::set<T>(*rayleighMixtureData, minimumMixtureCount, (mixtureSeed.size() == dimension ? &mixtureSeed[0] : NULL));
+
+			if (!fitSignature.empty() && !rayleighMixtureData->solution.empty()) {
+				mixtureFitCache->insert(fitSignature, rayleighMixtureData->solution);
+			}
+		}
+		_logger->endTimer("DetermineMixtureParameters::set<T>\t= ");
+
+		mixtureSolution = rayleighMixtureData->solution;
+		mixtureError = rayleighMixtureData->finalError;
+		fitIterationCount += rayleighMixtureData->iterationCount;
+
+		FastTargetDetector<T> fastTargetDetector;
+		const int maximumWindowRadius = (fastTargetDetector.getMaximumExpansion() - 1) * windowRadius;
+
+		IntegralImageData<T>* integralImageData = new IntegralImageData<T>(*rayleighMixtureData, integralImageLayout, integralImageStorage, maximumWindowRadius, threadCount,
+			(deferredIntegralImages ? BuilderDeferred : BuilderRowColumn), tileArena);
+		_logger->endTimer("IntegralImageData<T>\t\t\t= ");
+
+		return new TypedTileCacheEntry<T>(image, rayleighMixtureData, integralImageData);
+	}
+
+	static int countMismatches(Mat& targetMap, Mat& referenceTargetMap, Rect workingRect)
+	{
+		int mismatchCount = 0;
+		for (int y = workingRect.y; y < workingRect.y + workingRect.height; y++) {
+			unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+			unsigned char* rrow = (unsigned char*)(referenceTargetMap.data + y * referenceTargetMap.step);
+
+			for (int x = workingRect.x; x < workingRect.x + workingRect.width; x++) {
+				if (trow[x] != rrow[x]) {
+					mismatchCount++;
+				}
+			}
+		}
+
+		return mismatchCount;
 	}
 
 	template<typename T>
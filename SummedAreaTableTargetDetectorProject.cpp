@@ -10,6 +10,7 @@
 #include "TileManager.h"
 #include "AdaptiveSimulatedAnnealingTest.h"
 #include "RayleighMixtureSummedAreaTableCFAR.h"
+#include "StreamingRayleighMixtureSummedAreaTableCFAR.h"
 #include "targetDetectors\AdaptiveAndFastCFAR.h"
 #include "targetDetectors\CellAveragingCFAR.h"
 #include "targetDetectors\AutoCensoredCFAR.h"
@@ -101,12 +102,23 @@ void createPerformanceTest(Mat& image, Mat& groundtruthImage, string testResults
 	double bestFPR = 0.0;
 	double bestTPR = 0.0;
 
-	for (int i = 0; i < PfaPowerList.size(); i++) {
-		const double PfaPower = PfaPowerList.at(i);
-		const double probabilityOfFalseAlarm = pow(10.0, PfaPower);
+	// Pfa does not change the fitted mixtures and SATs, so they are cached within an experiment and refitted for the next one
+	map<string, double> testParameters = parameters;
+	testParameters["RmSAT-CFAR.cacheTileData"] = 1;
 
-		for (int j=0; j<experimentCount; j++) {
-			Mat targetMap = CFARtargetDetector->execute(image, probabilityOfFalseAlarm, parameters);
+	for (int j=0; j<experimentCount; j++) {
+		CFARtargetDetector->releaseCache();
+
+		// detectors that support it produce the false alarm probability map once, every Pfa is then a single threshold pass
+		Mat probabilityMap = CFARtargetDetector->executeProbabilityMap(image, testParameters);
+
+		for (int i = 0; i < PfaPowerList.size(); i++) {
+			const double PfaPower = PfaPowerList.at(i);
+			const double probabilityOfFalseAlarm = pow(10.0, PfaPower);
+
+			Mat targetMap = probabilityMap.empty() ?
+				CFARtargetDetector->execute(image, probabilityOfFalseAlarm, testParameters) :
+				AbstractCFAR::applyProbabilityOfFalseAlarm(probabilityMap, probabilityOfFalseAlarm);
 
 			pair<double, double>performanceValues = createPerformanceValues(targetMap, groundtruthImage);
 			const double FalsePositiveRate = performanceValues.first;
@@ -136,6 +148,7 @@ void createPerformanceTest(Mat& image, Mat& groundtruthImage, string testResults
 			}
 		}
 	}
+	CFARtargetDetector->releaseCache();
 	cout << "Completed in " << timeMeasurer.getTimeNanosecond() / 1000.0 << " seconds" << endl;
 
 	// save results
@@ -316,6 +329,289 @@ void RayleighMixtureTest()
 }
 
 
+template<typename T>
+bool areIntegralImagesEqual(IntegralImageData<T>& integralImageData1, IntegralImageData<T>& integralImageData2)
+{
+	const int rowLength1 = integralImageData1.I2.cols * (int)integralImageData1.I2.elemSize();
+	const int rowLength2 = integralImageData1.C.cols * (int)integralImageData1.C.elemSize();
+
+	for (int y = 0; y < integralImageData1.I2.rows; y++) {
+		if (memcmp(integralImageData1.I2.data + y * integralImageData1.I2.step, integralImageData2.I2.data + y * integralImageData2.I2.step, rowLength1) != 0 ||
+			memcmp(integralImageData1.C.data + y * integralImageData1.C.step, integralImageData2.C.data + y * integralImageData2.C.step, rowLength2) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<typename T>
+void IntegralImageBuilderBenchmark(Mat& image)
+{
+	Mat globalHistogram;
+	ImageUtilities::addToHistogram(image, globalHistogram);
+
+	const int histogramSize = 250;
+	const int maximumMixtureCount = 5;
+	const int minimumMixtureCount = 1;
+	const double probabilityOfFalseAlarm = 1e-5;
+	RayleighMixtureData rayleighMixtureData(image, globalHistogram, histogramSize, maximumMixtureCount, probabilityOfFalseAlarm);
+	DetermineMixtureParameters::set<T>(rayleighMixtureData, minimumMixtureCount);
+
+	cout << "SAT construction benchmark " << image.size() << ", interval count = " << rayleighMixtureData.intervalCount << endl;
+	cout << "-------------------------------------------------------" << endl;
+
+	const int repeatCount = 10;
+	const int windowRadius = 3 * 10;
+
+	IntegralImageLayout layouts[] = { LayoutPlanar, LayoutInterleaved };
+	IntegralImageStorage storages[] = { StorageDouble, StorageCompact };
+
+	for (int l = 0; l < 2; l++) {
+		for (int s = 0; s < 2; s++) {
+			IntegralImageData<T> reference(rayleighMixtureData, layouts[l], storages[s], windowRadius, 1, BuilderRecurrence);
+
+			TimeMeasurer timeMeasurer;
+			for (int r = 0; r < repeatCount; r++) {
+				IntegralImageData<T> integralImageData(rayleighMixtureData, layouts[l], storages[s], windowRadius, 1, BuilderRecurrence);
+			}
+			const double recurrenceTime = timeMeasurer.getTimeNanosecond() / repeatCount;
+
+			cout << (layouts[l] == LayoutPlanar ? "planar     " : "interleaved") << " " << (reference.storage == StorageDouble ? "double " : "compact") << " : ";
+			cout << "recurrence = " << recurrenceTime << " msecs";
+
+			for (int threadCount = 1; threadCount <= omp_get_max_threads(); threadCount *= 2) {
+				timeMeasurer.resetTimer();
+				for (int r = 0; r < repeatCount; r++) {
+					IntegralImageData<T> integralImageData(rayleighMixtureData, layouts[l], storages[s], windowRadius, threadCount, BuilderRowColumn);
+				}
+				const double rowColumnTime = timeMeasurer.getTimeNanosecond() / repeatCount;
+
+				IntegralImageData<T> integralImageData(rayleighMixtureData, layouts[l], storages[s], windowRadius, threadCount, BuilderRowColumn);
+				const bool isEqual = areIntegralImagesEqual<T>(reference, integralImageData);
+
+				cout << ", row-column (" << threadCount << " threads) = " << rowColumnTime << " msecs" << (isEqual ? "" : " (MISMATCH)");
+			}
+			cout << endl;
+		}
+	}
+	cout << endl;
+}
+
+void IntegralImageBuilderBenchmark()
+{
+	Mat image = imread("_images\\im1024.tif", CV_LOAD_IMAGE_UNCHANGED);
+
+	switch (image.type())
+	{
+	case CV_8U:  IntegralImageBuilderBenchmark<unsigned char>(image);	break;
+	case CV_16U: IntegralImageBuilderBenchmark<unsigned short>(image);	break;
+	default: cout << "Unsupported image type for SAT construction benchmark!" << endl;
+	}
+}
+
+// pushes the image row by row into the streaming detector and reports the row latency and the agreement with the tiled detector
+void StreamingDetectionTest()
+{
+	Mat image = imread("_images\\im1024.tif", CV_LOAD_IMAGE_UNCHANGED);
+
+	const double probabilityOfFalseAlarm = 1e-5;
+	map<string, double> parameters;
+	parameters["RmSAT-CFAR.leadingRowCount"] = 256;
+
+	TimeMeasurer timeMeasurer;
+
+	StreamingRayleighMixtureSummedAreaTableCFAR streamingDetector(image.cols, image.type(), probabilityOfFalseAlarm, parameters);
+	Mat streamedTargetMap(image.rows, image.cols, CV_8UC1);
+
+	int maximumLatency = 0;
+	Mat targetRow;
+	int rowIndex;
+	for (int y = 0; y < image.rows; y++) {
+		Mat imageRow = image.row(y);
+		streamingDetector.pushRow(imageRow);
+
+		while (streamingDetector.popTargetRow(targetRow, rowIndex)) {
+			Mat streamedRow = streamedTargetMap.row(rowIndex);
+			targetRow.copyTo(streamedRow);
+			maximumLatency = max(maximumLatency, y - rowIndex);
+		}
+	}
+
+	streamingDetector.finish();
+	while (streamingDetector.popTargetRow(targetRow, rowIndex)) {
+		Mat streamedRow = streamedTargetMap.row(rowIndex);
+		targetRow.copyTo(streamedRow);
+	}
+
+	const double streamingTime = timeMeasurer.getTimeNanosecond();
+
+	RayleighMixtureSummedAreaTableCFAR tiledDetector;
+	timeMeasurer.resetTimer();
+	Mat targetMap = tiledDetector.execute(image, probabilityOfFalseAlarm, parameters);
+	const double tiledTime = timeMeasurer.getTimeNanosecond();
+
+	const double pixelCount = (double)image.rows * image.cols;
+	cout << "Streaming RmSAT-CFAR " << image.size() << " : " << streamingTime << " msecs, maximum row latency = " << maximumLatency << " rows (leading block = " << parameters["RmSAT-CFAR.leadingRowCount"] << " rows)" << endl;
+	cout << "Streamed target pixel ratio = " << countNonZero(streamedTargetMap) / pixelCount << endl;
+	cout << "Tiled RmSAT-CFAR : " << tiledTime << " msecs, target pixel ratio = " << countNonZero(targetMap) / pixelCount << endl;
+	cout << "Differing decisions = " << countNonZero(streamedTargetMap != targetMap) << endl;
+	cout << endl;
+
+	imwrite("_testResults\\im1024_streamedTargetMap.png", UCHAR_MAX - streamedTargetMap);
+}
+
+
+// area under the ROC curve of (FPR, TPR) points by the trapezoid rule, (0,0) and (1,1) are added as end points
+double calculateAreaUnderCurve(vector<pair<double, double> > rocPoints)
+{
+	rocPoints.push_back(pair<double, double>(0.0, 0.0));
+	rocPoints.push_back(pair<double, double>(1.0, 1.0));
+	sort(rocPoints.begin(), rocPoints.end());
+
+	double area = 0.0;
+	for (int i = 1; i < rocPoints.size(); i++) {
+		area += (rocPoints[i].first - rocPoints[i - 1].first) * (rocPoints[i].second + rocPoints[i - 1].second) * 0.5;
+	}
+
+	return area;
+}
+
+// detection time and ROC area of the table based exp for several relative error bounds, the mixture fit is done once and shared by all bounds
+void ExponentialTableBenchmark(Mat& image, Mat& groundtruthImage)
+{
+	if (groundtruthImage.empty()) {
+		return;
+	}
+
+	const double relativeErrors[] = { 0.0, 1e-6, 1e-4, 1e-3, 1e-2, 5e-2 };
+	const int relativeErrorCount = sizeof(relativeErrors) / sizeof(relativeErrors[0]);
+	const double referenceProbabilityOfFalseAlarm = 1e-5;
+
+	vector<double> PfaPowerList;
+	for (double PfaPower = 0.0; PfaPower >= -6.0; PfaPower -= 0.1) {
+		PfaPowerList.push_back(PfaPower);
+	}
+
+	map<string, double> parameters;
+	parameters["RmSAT-CFAR.guardRadius"] = 5;
+	parameters["RmSAT-CFAR.clutterRadius"] = 5;
+	parameters["RmSAT-CFAR.minimumMixtureCount"] = 1;
+	parameters["RmSAT-CFAR.maximumMixtureCount"] = 5;
+	parameters["RmSAT-CFAR.cacheTileData"] = 1;
+
+	RayleighMixtureSummedAreaTableCFAR CFARtargetDetector;
+	CFARtargetDetector.setThreadCount(8);
+
+	cout << "Exponential table benchmark " << image.size() << " (" << PfaPowerList.size() << " Pfa values per bound)" << endl;
+	cout << "-------------------------------------------------------" << endl;
+
+	Mat referenceTargetMap;
+	double referenceTime = 0.0;
+	double referenceArea = 0.0;
+	for (int e = 0; e < relativeErrorCount; e++) {
+		parameters["RmSAT-CFAR.exponentialRelativeError"] = relativeErrors[e];
+
+		// first call fills the cache (or reuses it), so the timed sweep only contains the detection pass
+		Mat targetMap = CFARtargetDetector.execute(image, referenceProbabilityOfFalseAlarm, parameters);
+		if (e == 0) {
+			referenceTargetMap = targetMap.clone();
+		}
+		const int mismatchCount = countNonZero(targetMap != referenceTargetMap);
+
+		vector<pair<double, double> > rocPoints;
+		double detectionTime = 0.0;
+		for (int i = 0; i < PfaPowerList.size(); i++) {
+			const double probabilityOfFalseAlarm = pow(10.0, PfaPowerList.at(i));
+
+			TimeMeasurer timeMeasurer;
+			targetMap = CFARtargetDetector.execute(image, probabilityOfFalseAlarm, parameters);
+			detectionTime += timeMeasurer.getTimeNanosecond();
+
+			rocPoints.push_back(createPerformanceValues(targetMap, groundtruthImage));
+		}
+		const double area = calculateAreaUnderCurve(rocPoints);
+
+		if (e == 0) {
+			referenceTime = detectionTime;
+			referenceArea = area;
+		}
+
+		cout << "relative error = " << relativeErrors[e];
+		if (relativeErrors[e] > 0.0) {
+			cout << " (table size = " << ExponentialTable(relativeErrors[e]).getTableSize() << ")";
+		}
+		cout << " : " << detectionTime << " msecs, speedup = " << referenceTime / detectionTime << ", AUC = " << area << " (" << showpos << area - referenceArea << noshowpos << ")";
+		cout << ", differing decisions at Pfa = " << referenceProbabilityOfFalseAlarm << " : " << mismatchCount << endl;
+	}
+	cout << endl;
+
+	CFARtargetDetector.releaseCache();
+}
+
+void ExponentialTableBenchmark()
+{
+	Mat image = imread("_images\\im1024.tif", CV_LOAD_IMAGE_UNCHANGED);
+	Mat groundtruthImage = imread("_groundTruths\\im1024_groundTruth.png", CV_LOAD_IMAGE_UNCHANGED);
+
+	Rect boundingBox = TileManager::findBoundingBox(image);
+	image = image(boundingBox).clone();
+	if (!groundtruthImage.empty()) {
+		groundtruthImage = groundtruthImage(boundingBox).clone();
+	}
+
+	ExponentialTableBenchmark(image, groundtruthImage);
+}
+
+
+// measured throughput of every candidate tile geometry of the planner against its estimated cost, the planned geometry is marked with *
+void TileGeometryBenchmark(Mat& image)
+{
+	const double probabilityOfFalseAlarm = 1e-5;
+	const int repeatCount = 3;
+
+	map<string, double> parameters;
+	RayleighMixtureSummedAreaTableCFAR CFARtargetDetector;
+
+	TileGeometryPlanner planner = CFARtargetDetector.createTileGeometryPlanner(parameters);
+	const CacheHierarchy& cacheHierarchy = planner.getCacheHierarchy();
+	const Size plannedTileSize = planner.plan(image.size());
+	const double plannedCost = planner.estimateCost(image.size(), plannedTileSize);
+
+	cout << "Tile geometry benchmark " << image.size() << ", " << CFARtargetDetector.getThreadCount() << " threads, L2 = " << cacheHierarchy.level2Size / 1024
+		<< " KB, L3 = " << cacheHierarchy.level3Size / 1024 << " KB" << endl;
+	cout << "-------------------------------------------------------" << endl;
+
+	const double pixelCount = (double)image.rows * image.cols;
+	vector<Size> tileSizes = planner.getCandidateTileSizes(image.size());
+	for (int i = 0; i < tileSizes.size(); i++) {
+		parameters["RmSAT-CFAR.tileWidth"] = tileSizes[i].width;
+		parameters["RmSAT-CFAR.tileHeight"] = tileSizes[i].height;
+
+		double executionTime = DBL_MAX;
+		for (int r = 0; r < repeatCount; r++) {
+			TimeMeasurer timeMeasurer;
+			CFARtargetDetector.execute(image, probabilityOfFalseAlarm, parameters);
+			executionTime = min(executionTime, timeMeasurer.getTimeNanosecond());
+		}
+
+		cout << (tileSizes[i] == plannedTileSize ? "* " : "  ") << tileSizes[i].width << " x " << tileSizes[i].height << " : " << executionTime << " msecs, "
+			<< pixelCount / (executionTime * 1000.0) << " Mpixels/sec, estimated cost = " << planner.estimateCost(image.size(), tileSizes[i]) / plannedCost << endl;
+	}
+	cout << endl;
+}
+
+void TileGeometryBenchmark()
+{
+	Mat image = imread("_images\\im1024.tif", CV_LOAD_IMAGE_UNCHANGED);
+
+	// a mosaic, so large tiles and strips are not limited by the image size
+	Mat mosaic;
+	repeat(image, 4, 4, mosaic);
+
+	TileGeometryBenchmark(mosaic);
+}
+
 int _tmain(int argc, _TCHAR* argv[])
 {
 	/*
@@ -344,6 +640,14 @@ int _tmain(int argc, _TCHAR* argv[])
 
 	///AdaptiveSimulatedAnnealingTest::execute();
 
+	///IntegralImageBuilderBenchmark();
+
+	///StreamingDetectionTest();
+
+	///ExponentialTableBenchmark();
+
+	///TileGeometryBenchmark();
+
 	RayleighMixtureTest();
 
 	return 0;
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <fstream>
+#include <algorithm>
+#include <opencv2\opencv.hpp>
+#include "TileManager.h"
+
+using namespace std;
+using namespace cv;
+
+
+// connected (8-neighbourhood) target pixels
+struct TargetBlob {
+	int area;
+	Rect boundingBox;
+	Point peakPosition;
+	double peakValue;
+	double valueSum;
+	double clutterSigma;		// Rayleigh sigma of the clutter around the peak (see FastTargetDetector::calculateClutterSigma)
+
+	TargetBlob()
+	{
+		area = 0;
+		peakValue = -DBL_MAX;
+		valueSum = 0.0;
+		clutterSigma = 0.0;
+	}
+
+	double getMeanValue() const
+	{
+		return (area > 0 ? valueSum / area : 0.0);
+	}
+
+	void addPixel(int x, int y, double value)
+	{
+		boundingBox = (area == 0 ? Rect(x, y, 1, 1) : (boundingBox | Rect(x, y, 1, 1)));
+		area++;
+		valueSum += value;
+
+		if (value > peakValue) {
+			peakValue = value;
+			peakPosition = Point(x, y);
+		}
+	}
+
+	// the clutter sigma follows the peak
+	void merge(const TargetBlob& blob)
+	{
+		boundingBox = (area == 0 ? blob.boundingBox : (boundingBox | blob.boundingBox));
+		area += blob.area;
+		valueSum += blob.valueSum;
+
+		if (blob.peakValue > peakValue) {
+			peakValue = blob.peakValue;
+			peakPosition = blob.peakPosition;
+			clutterSigma = blob.clutterSigma;
+		}
+	}
+};
+
+// blobs of the working rectangle of one tile, blobs touching the rectangle border may continue in the neighbouring tiles,
+// so the blob index of every border pixel is kept (-1 : not a target) to merge them across the tile seams
+struct TileBlobs {
+	Rect rect;					// working rectangle
+	vector<TargetBlob> blobs;
+	vector<int> topLabels;
+	vector<int> bottomLabels;
+	vector<int> leftLabels;
+	vector<int> rightLabels;
+};
+
+class TargetBlobExtractor {
+public:
+	// labels the target pixels of targetMap within workingRect with union-find, pixel values are taken from valueImage (same geometry as targetMap),
+	// positions are in tile coordinates (see translate)
+	static void labelTile(Mat& targetMap, Mat& valueImage, Rect workingRect, TileBlobs& tileBlobs)
+	{
+		switch (valueImage.depth())
+		{
+		case CV_8U:  labelTile<unsigned char>(targetMap, valueImage, workingRect, tileBlobs);	break;
+		case CV_8S:  labelTile<char>(targetMap, valueImage, workingRect, tileBlobs);			break;
+		case CV_16U: labelTile<unsigned short>(targetMap, valueImage, workingRect, tileBlobs);	break;
+		case CV_16S: labelTile<short>(targetMap, valueImage, workingRect, tileBlobs);			break;
+		case CV_32S: labelTile<int>(targetMap, valueImage, workingRect, tileBlobs);				break;
+		case CV_32F: labelTile<float>(targetMap, valueImage, workingRect, tileBlobs);			break;
+		case CV_64F: labelTile<double>(targetMap, valueImage, workingRect, tileBlobs);			break;
+		}
+	}
+
+	// moves the blobs of a tile into image coordinates (tileOrigin : image position of the tile's top-left pixel)
+	static void translate(TileBlobs& tileBlobs, Point tileOrigin)
+	{
+		tileBlobs.rect += tileOrigin;
+
+		for (int i = 0; i < tileBlobs.blobs.size(); i++) {
+			tileBlobs.blobs[i].boundingBox += tileOrigin;
+			tileBlobs.blobs[i].peakPosition += tileOrigin;
+		}
+	}
+
+	// merges the blobs of neighbouring tiles (tileBlobs is in the order of tileManager.getTileIndices()) that touch across a seam, result is in raster order of the peaks
+	static vector<TargetBlob> mergeTileBlobs(vector<TileBlobs>& tileBlobs, TileManager& tileManager)
+	{
+		vector<pair<int, int>> tileIndices = tileManager.getTileIndices();
+
+		// global blob index = offset of the tile + blob index within the tile
+		vector<int> blobOffsets(tileBlobs.size() + 1, 0);
+		for (int i = 0; i < tileBlobs.size(); i++) {
+			blobOffsets[i + 1] = blobOffsets[i] + (int)tileBlobs[i].blobs.size();
+		}
+
+		vector<int> parents(blobOffsets.back());
+		for (int i = 0; i < parents.size(); i++) {
+			parents[i] = i;
+		}
+
+		map<pair<int, int>, int> tilePositions;
+		for (int i = 0; i < tileIndices.size(); i++) {
+			tilePositions[tileIndices[i]] = i;
+		}
+
+		for (int i = 0; i < tileIndices.size(); i++) {
+			const int tileXindex = tileIndices[i].first;
+			const int tileYindex = tileIndices[i].second;
+			const TileBlobs& tile = tileBlobs[i];
+
+			// right neighbour, working rectangles may be cropped (see TileManager::setOccupancyIndex), so border pixels are matched by image position
+			map<pair<int, int>, int>::iterator neighbour = tilePositions.find(pair<int, int>(tileXindex + 1, tileYindex));
+			if (neighbour != tilePositions.end() && tile.rect.x + tile.rect.width == tileBlobs[neighbour->second].rect.x) {
+				const TileBlobs& rightTile = tileBlobs[neighbour->second];
+				const int offset = tile.rect.y - rightTile.rect.y;
+				for (int y = 0; y < tile.rightLabels.size(); y++) {
+					for (int dy = -1; dy <= 1; dy++) {
+						if (y + offset + dy >= 0 && y + offset + dy < rightTile.leftLabels.size()) {
+							unite(parents, blobOffsets, i, tile.rightLabels[y], neighbour->second, rightTile.leftLabels[y + offset + dy]);
+						}
+					}
+				}
+			}
+
+			// bottom neighbour
+			neighbour = tilePositions.find(pair<int, int>(tileXindex, tileYindex + 1));
+			if (neighbour != tilePositions.end() && tile.rect.y + tile.rect.height == tileBlobs[neighbour->second].rect.y) {
+				const TileBlobs& bottomTile = tileBlobs[neighbour->second];
+				const int offset = tile.rect.x - bottomTile.rect.x;
+				for (int x = 0; x < tile.bottomLabels.size(); x++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						if (x + offset + dx >= 0 && x + offset + dx < bottomTile.topLabels.size()) {
+							unite(parents, blobOffsets, i, tile.bottomLabels[x], neighbour->second, bottomTile.topLabels[x + offset + dx]);
+						}
+					}
+				}
+			}
+
+			// diagonal neighbours only touch at the corners
+			neighbour = tilePositions.find(pair<int, int>(tileXindex + 1, tileYindex + 1));
+			if (neighbour != tilePositions.end() && !tile.bottomLabels.empty() && !tileBlobs[neighbour->second].topLabels.empty()
+				&& tile.rect.br() == tileBlobs[neighbour->second].rect.tl()) {
+				unite(parents, blobOffsets, i, tile.bottomLabels.back(), neighbour->second, tileBlobs[neighbour->second].topLabels.front());
+			}
+
+			neighbour = tilePositions.find(pair<int, int>(tileXindex - 1, tileYindex + 1));
+			if (neighbour != tilePositions.end() && !tile.bottomLabels.empty() && !tileBlobs[neighbour->second].topLabels.empty()
+				&& tile.rect.x == tileBlobs[neighbour->second].rect.x + tileBlobs[neighbour->second].rect.width && tile.rect.y + tile.rect.height == tileBlobs[neighbour->second].rect.y) {
+				unite(parents, blobOffsets, i, tile.bottomLabels.front(), neighbour->second, tileBlobs[neighbour->second].topLabels.back());
+			}
+		}
+
+		// accumulate every blob into its root
+		vector<TargetBlob> mergedBlobs(parents.size());
+		vector<bool> isRoot(parents.size(), false);
+		for (int i = 0; i < tileBlobs.size(); i++) {
+			for (int j = 0; j < tileBlobs[i].blobs.size(); j++) {
+				const int root = findRoot(parents, blobOffsets[i] + j);
+				mergedBlobs[root].merge(tileBlobs[i].blobs[j]);
+				isRoot[root] = true;
+			}
+		}
+
+		vector<TargetBlob> blobs;
+		for (int i = 0; i < mergedBlobs.size(); i++) {
+			if (isRoot[i]) {
+				blobs.push_back(mergedBlobs[i]);
+			}
+		}
+
+		sort(blobs.begin(), blobs.end(), isBefore);
+
+		return blobs;
+	}
+
+	static bool writeCSV(string fileName, const vector<TargetBlob>& blobs)
+	{
+		ofstream file(fileName);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file << "area,x,y,width,height,peakX,peakY,peakValue,meanValue,clutterSigma" << endl;
+		for (int i = 0; i < blobs.size(); i++) {
+			const TargetBlob& blob = blobs[i];
+			file << blob.area << "," << blob.boundingBox.x << "," << blob.boundingBox.y << "," << blob.boundingBox.width << "," << blob.boundingBox.height << ","
+				<< blob.peakPosition.x << "," << blob.peakPosition.y << "," << blob.peakValue << "," << blob.getMeanValue() << "," << blob.clutterSigma << "\n";
+		}
+
+		return file.good();
+	}
+
+private:
+	template<typename T>
+	static void labelTile(Mat& targetMap, Mat& valueImage, Rect workingRect, TileBlobs& tileBlobs)
+	{
+		const int width = workingRect.width;
+		const int height = workingRect.height;
+
+		tileBlobs.rect = workingRect;
+		tileBlobs.blobs.clear();
+
+		// first pass : provisional labels, the labels of the already visited 8-neighbours (left, upper-left, up, upper-right) are united
+		Mat labels(height, width, CV_32SC1, Scalar(-1));
+		vector<int> parents;
+
+		for (int y = 0; y < height; y++) {
+			const unsigned char* trow = (unsigned char*)(targetMap.data + (y + workingRect.y) * targetMap.step) + workingRect.x;
+			int* lrow = (int*)(labels.data + y * labels.step);
+			const int* plrow = (y > 0 ? (int*)(labels.data + (y - 1) * labels.step) : NULL);
+
+			for (int x = 0; x < width; x++) {
+				if (trow[x] == 0) {
+					continue;
+				}
+
+				int label = -1;
+				const int neighbourLabels[4] = { (x > 0 ? lrow[x - 1] : -1), (plrow != NULL && x > 0 ? plrow[x - 1] : -1), (plrow != NULL ? plrow[x] : -1),
+					(plrow != NULL && x + 1 < width ? plrow[x + 1] : -1) };
+
+				for (int i = 0; i < 4; i++) {
+					if (neighbourLabels[i] < 0) {
+						continue;
+					}
+
+					if (label < 0)
+						label = findRoot(parents, neighbourLabels[i]);
+					else
+						label = uniteRoots(parents, label, findRoot(parents, neighbourLabels[i]));
+				}
+
+				if (label < 0) {
+					label = (int)parents.size();
+					parents.push_back(label);
+				}
+
+				lrow[x] = label;
+			}
+		}
+
+		// second pass : compact blob indices and blob attributes
+		vector<int> blobIndices(parents.size(), -1);
+		for (int y = 0; y < height; y++) {
+			const T* vrow = (T*)(valueImage.data + (y + workingRect.y) * valueImage.step) + workingRect.x;
+			int* lrow = (int*)(labels.data + y * labels.step);
+
+			for (int x = 0; x < width; x++) {
+				if (lrow[x] < 0) {
+					continue;
+				}
+
+				const int root = findRoot(parents, lrow[x]);
+				if (blobIndices[root] < 0) {
+					blobIndices[root] = (int)tileBlobs.blobs.size();
+					tileBlobs.blobs.push_back(TargetBlob());
+				}
+
+				lrow[x] = blobIndices[root];
+				tileBlobs.blobs[lrow[x]].addPixel(x + tileBlobs.rect.x, y + tileBlobs.rect.y, vrow[x]);
+			}
+		}
+
+		tileBlobs.topLabels.assign((int*)labels.data, (int*)labels.data + width);
+		tileBlobs.bottomLabels.assign((int*)(labels.data + (height - 1) * labels.step), (int*)(labels.data + (height - 1) * labels.step) + width);
+		tileBlobs.leftLabels.resize(height);
+		tileBlobs.rightLabels.resize(height);
+		for (int y = 0; y < height; y++) {
+			const int* lrow = (int*)(labels.data + y * labels.step);
+			tileBlobs.leftLabels[y] = lrow[0];
+			tileBlobs.rightLabels[y] = lrow[width - 1];
+		}
+	}
+
+	static int findRoot(vector<int>& parents, int label)
+	{
+		while (parents[label] != label) {
+			parents[label] = parents[parents[label]];
+			label = parents[label];
+		}
+
+		return label;
+	}
+
+	// the smaller label becomes the root, so labels only point to earlier labels
+	static int uniteRoots(vector<int>& parents, int root1, int root2)
+	{
+		const int root = min(root1, root2);
+		parents[root1] = root;
+		parents[root2] = root;
+
+		return root;
+	}
+
+	static void unite(vector<int>& parents, vector<int>& blobOffsets, int tile1, int blob1, int tile2, int blob2)
+	{
+		if (blob1 < 0 || blob2 < 0) {
+			return;
+		}
+
+		uniteRoots(parents, findRoot(parents, blobOffsets[tile1] + blob1), findRoot(parents, blobOffsets[tile2] + blob2));
+	}
+
+	static bool isBefore(const TargetBlob& blob1, const TargetBlob& blob2)
+	{
+		return (blob1.peakPosition.y < blob2.peakPosition.y || (blob1.peakPosition.y == blob2.peakPosition.y && blob1.peakPosition.x < blob2.peakPosition.x));
+	}
+
+};
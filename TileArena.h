@@ -0,0 +1,231 @@
+#pragma once
+
+#include <windows.h>
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+#include <opencv2\opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+
+// Bump allocator for the working memory of one tile (refined tile, censor map, mixture arrays and SATs). The memory is reserved and committed once,
+// optionally on large pages, allocations are Mat headers over it and reset releases all of them at once, so no page is faulted in twice and the heap
+// is not touched while a tile is processed. Requests that do not fit fall back to ordinary Mats, the next reset grows the arena to the requested total.
+class TileArena {
+public:
+	TileArena(size_t capacity = 0, bool largePages = false)
+	{
+		memory = NULL;
+		this->capacity = 0;
+		this->largePages = false;
+		offset = 0;
+		requestedSize = 0;
+
+		reserve(capacity, largePages);
+	}
+
+	virtual ~TileArena()
+	{
+		release();
+	}
+
+	// large pages need the "Lock pages in memory" privilege enabled in the process token (see TileArenaPool::enableLockMemoryPrivilege), regular
+	// pages are used if they cannot be allocated
+	void reserve(size_t capacity, bool largePages)
+	{
+		release();
+
+		if (capacity == 0) {
+			return;
+		}
+
+		if (largePages) {
+			const size_t largePageSize = GetLargePageMinimum();
+
+			if (largePageSize > 0) {
+				const size_t largeCapacity = (capacity + largePageSize - 1) / largePageSize * largePageSize;
+				memory = (unsigned char*)VirtualAlloc(NULL, largeCapacity, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+				if (memory != NULL) {
+					this->capacity = largeCapacity;
+					this->largePages = true;
+					return;
+				}
+			}
+		}
+
+		memory = (unsigned char*)VirtualAlloc(NULL, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		this->capacity = (memory != NULL ? capacity : 0);
+	}
+
+	// continuous Mat in the arena, valid until the next reset
+	Mat allocate(int rows, int cols, int type)
+	{
+		const size_t alignment = 64;
+		const size_t size = (size_t)rows * cols * CV_ELEM_SIZE(type);
+		const size_t alignedSize = (size + alignment - 1) / alignment * alignment;
+
+		requestedSize += alignedSize;
+
+		if (memory == NULL || offset + alignedSize > capacity) {
+			return Mat(rows, cols, type);
+		}
+
+		Mat mat(rows, cols, type, memory + offset);
+		offset += alignedSize;
+
+		return mat;
+	}
+
+	// Mat of the arena or, without arena, an ordinary Mat
+	static Mat allocate(TileArena* arena, int rows, int cols, int type)
+	{
+		return (arena != NULL ? arena->allocate(rows, cols, type) : Mat(rows, cols, type));
+	}
+
+	// every Mat allocated since the last reset must be released, the arena grows if the last tile did not fit
+	void reset()
+	{
+		if (requestedSize > capacity) {
+			reserve(requestedSize + requestedSize / 4, largePages);
+		}
+
+		offset = 0;
+		requestedSize = 0;
+	}
+
+	size_t getCapacity() const
+	{
+		return capacity;
+	}
+
+	bool usesLargePages() const
+	{
+		return largePages;
+	}
+
+private:
+	unsigned char* memory;
+	size_t capacity;
+	bool largePages;
+	size_t offset;
+	size_t requestedSize;
+
+	void release()
+	{
+		if (memory != NULL) {
+			VirtualFree(memory, 0, MEM_RELEASE);
+		}
+
+		memory = NULL;
+		capacity = 0;
+		largePages = false;
+	}
+};
+
+// Arenas of the tiles in flight, a tile acquires an arena when it is started and releases it when its data is released. With tile loops this is one
+// arena per thread, tile tasks may keep a few more tiles in flight than there are threads.
+class TileArenaPool {
+public:
+	TileArenaPool(size_t capacity, bool largePages)
+	{
+		this->capacity = capacity;
+		this->largePages = largePages;
+
+		if (largePages) {
+			enableLockMemoryPrivilege();
+		}
+
+		omp_init_lock(&lock);
+	}
+
+	virtual ~TileArenaPool()
+	{
+		for (int i = 0; i < arenas.size(); i++) {
+			delete arenas[i];
+		}
+
+		omp_destroy_lock(&lock);
+	}
+
+	TileArena* acquire()
+	{
+		TileArena* arena = NULL;
+
+		omp_set_lock(&lock);
+		if (!freeArenas.empty()) {
+			arena = freeArenas.back();
+			freeArenas.pop_back();
+		}
+		else {
+			arena = new TileArena(capacity, largePages);
+			arenas.push_back(arena);
+		}
+		omp_unset_lock(&lock);
+
+		return arena;
+	}
+
+	void release(TileArena* arena)
+	{
+		arena->reset();
+
+		omp_set_lock(&lock);
+		freeArenas.push_back(arena);
+		omp_unset_lock(&lock);
+	}
+
+	int getArenaCount() const
+	{
+		return (int)arenas.size();
+	}
+
+	// arenas that actually got large pages
+	int getLargePageArenaCount() const
+	{
+		int largePageArenaCount = 0;
+		for (int i = 0; i < arenas.size(); i++) {
+			largePageArenaCount += (arenas[i]->usesLargePages() ? 1 : 0);
+		}
+
+		return largePageArenaCount;
+	}
+
+	// The "Lock pages in memory" privilege granted to the user is disabled in the process token until it is adjusted, it is enabled once per
+	// process (false if it is not granted)
+	static bool enableLockMemoryPrivilege()
+	{
+		static const bool isEnabled = adjustLockMemoryPrivilege();
+
+		return isEnabled;
+	}
+
+private:
+	size_t capacity;
+	bool largePages;
+	vector<TileArena*> arenas;
+	vector<TileArena*> freeArenas;
+	omp_lock_t lock;
+
+	static bool adjustLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+			return false;
+		}
+
+		TOKEN_PRIVILEGES privileges;
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the privilege is not granted
+		const bool isEnabled = (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS);
+
+		CloseHandle(token);
+
+		return isEnabled;
+	}
+};
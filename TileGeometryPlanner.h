@@ -0,0 +1,233 @@
+#pragma once
+
+#include <windows.h>
+#include <vector>
+#include <algorithm>
+#include <opencv2\opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+
+// data cache sizes in bytes (level 2 is per core, level 3 is shared by all cores)
+struct CacheHierarchy {
+	int level1Size;
+	int level2Size;
+	int level3Size;
+
+	CacheHierarchy(int level1Size = 32 * 1024, int level2Size = 256 * 1024, int level3Size = 8 * 1024 * 1024)
+	{
+		this->level1Size = level1Size;
+		this->level2Size = level2Size;
+		this->level3Size = level3Size;
+	}
+
+	// caches of the running machine, the defaults are kept for levels that are not reported
+	static CacheHierarchy detect()
+	{
+		CacheHierarchy cacheHierarchy;
+
+		DWORD bufferSize = 0;
+		GetLogicalProcessorInformation(NULL, &bufferSize);
+		if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || bufferSize == 0) {
+			return cacheHierarchy;
+		}
+
+		vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> processorInformation(bufferSize / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (!GetLogicalProcessorInformation(&processorInformation[0], &bufferSize)) {
+			return cacheHierarchy;
+		}
+
+		int cacheSizes[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < processorInformation.size(); i++) {
+			const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& information = processorInformation[i];
+
+			if (information.Relationship == RelationCache && information.Cache.Level <= 3 && information.Cache.Type != CacheInstruction) {
+				cacheSizes[information.Cache.Level] = max(cacheSizes[information.Cache.Level], (int)information.Cache.Size);
+			}
+		}
+
+		if (cacheSizes[1] > 0) cacheHierarchy.level1Size = cacheSizes[1];
+		if (cacheSizes[2] > 0) cacheHierarchy.level2Size = cacheSizes[2];
+		if (cacheSizes[3] > 0) cacheHierarchy.level3Size = cacheSizes[3];
+
+		return cacheHierarchy;
+	}
+};
+
+// Picks the tile geometry of RmSAT-CFAR (including full-width strips) with the lowest estimated processing time of an image. A tile costs a mixture
+// fit (fitPixelEquivalent pixels per mixture, independent of the tile size) plus mixtureCount per pixel of the tile and its bands, per-pixel costs grow
+// if the SAT rows swept by the detection window do not fit into level 2 or the SATs of the concurrently processed tiles do not fit into level 3 (they
+// are then read back from memory by the detection). Costs are in relative units, TileGeometryBenchmark compares them to measured throughput.
+// The cost model favours few large tiles (a fit is cheaper than the pixels it spares), so the candidates are bounded: a tile keeps at most
+// maximumTilePixelCount pixels, the area the mixture still models the local clutter of, and the concurrently processed tiles fit into
+// concurrentMemoryBudget bytes.
+class TileGeometryPlanner {
+public:
+	TileGeometryPlanner(CacheHierarchy cacheHierarchy, int threadCount, int mixtureCount, int windowRadius, int bandSize, bool taskScheduling = true,
+		bool compactStorage = false)
+	{
+		this->cacheHierarchy = cacheHierarchy;
+		this->threadCount = max(threadCount, 1);
+		this->mixtureCount = max(mixtureCount, 1);
+		this->bandSize = bandSize;
+		this->taskScheduling = taskScheduling;
+
+		// rows between the top and bottom corners of the largest window (FastTargetDetector expands up to 3 window radii)
+		sweptRowCount = 2 * 3 * windowRadius + 2;
+
+		// I2 and C per interval, plus input, refined tile, censor map, membership and result per pixel
+		integralImageBytesPerPixel = mixtureCount * (compactStorage ? 4 + 2 : 8 + 4);
+		tileBytesPerPixel = integralImageBytesPerPixel + 2 + 2 + 1 + 1 + 1;
+
+		fitPixelEquivalent = 16384.0;
+		level2Penalty = 0.25;
+		level3Penalty = 0.5;
+		minimumTilePixelCount = 256 * 256;
+		maximumTilePixelCount = 1024 * 1024;
+		concurrentMemoryBudget = 2.0 * 1024 * 1024 * 1024;
+	}
+
+	// pixels a tile needs for a reliable mixture fit
+	int getMinimumTilePixelCount() const { return minimumTilePixelCount; }
+
+	Size plan(Size imageSize) const
+	{
+		vector<Size> candidates = getCandidateTileSizes(imageSize);
+
+		Size bestTileSize = candidates.front();
+		double bestCost = estimateCost(imageSize, bestTileSize);
+		for (int i = 1; i < candidates.size(); i++) {
+			const double cost = estimateCost(imageSize, candidates[i]);
+
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestTileSize = candidates[i];
+			}
+		}
+
+		return bestTileSize;
+	}
+
+	// square tiles and full-width strips with power of two sides from 128 up to the image size, smaller tiles are only used if the image is smaller,
+	// as the mixture fit needs minimumTilePixelCount pixels, larger ones are dropped by maximumTilePixelCount and concurrentMemoryBudget (the
+	// smallest tile is kept if no tile fits into the budget)
+	vector<Size> getCandidateTileSizes(Size imageSize) const
+	{
+		vector<int> widths;
+		vector<int> heights;
+		for (int side = 128; side < 2 * max(imageSize.width, imageSize.height); side *= 2) {
+			if (side < 2 * imageSize.width) widths.push_back(min(side, imageSize.width));
+			if (side < 2 * imageSize.height) heights.push_back(min(side, imageSize.height));
+		}
+		widths.push_back(imageSize.width);
+		heights.push_back(imageSize.height);
+
+		vector<Size> candidates;
+		Size smallestTileSize = imageSize;
+		for (int i = 0; i < widths.size(); i++) {
+			for (int j = 0; j < heights.size(); j++) {
+				const Size tileSize(widths[i], heights[j]);
+
+				const bool isSquare = (tileSize.width == tileSize.height || tileSize.width == imageSize.width || tileSize.height == imageSize.height);
+				const bool isStrip = (tileSize.width == imageSize.width);
+				const bool isLargeEnough = (tileSize.area() >= minimumTilePixelCount || tileSize.area() == imageSize.area());
+				const bool isLocal = (tileSize.area() <= maximumTilePixelCount);
+
+				if (!(isSquare || isStrip) || !isLargeEnough || !isLocal) {
+					continue;
+				}
+
+				if (tileSize.area() < smallestTileSize.area()) {
+					smallestTileSize = tileSize;
+				}
+				if (getConcurrentBytes(imageSize, tileSize) <= concurrentMemoryBudget && find(candidates.begin(), candidates.end(), tileSize) == candidates.end()) {
+					candidates.push_back(tileSize);
+				}
+			}
+		}
+
+		if (candidates.empty()) {
+			candidates.push_back(smallestTileSize);
+		}
+
+		return candidates;
+	}
+
+	// estimated processing time of the image in relative units
+	double estimateCost(Size imageSize, Size tileSize) const
+	{
+		const int tileXcount = (imageSize.width + tileSize.width - 1) / tileSize.width;
+		const int tileYcount = (imageSize.height + tileSize.height - 1) / tileSize.height;
+		const int tileCount = tileXcount * tileYcount;
+
+		const double fitCost = fitPixelEquivalent * mixtureCount;
+
+		double totalCost = 0.0;
+		double largestPixelCost = 0.0;
+		for (int yy = 0; yy < tileYcount; yy++) {
+			for (int xx = 0; xx < tileXcount; xx++) {
+				const int x1 = max(xx * tileSize.width - bandSize, 0);
+				const int y1 = max(yy * tileSize.height - bandSize, 0);
+				const int x2 = min((xx + 1) * tileSize.width + bandSize, imageSize.width);
+				const int y2 = min((yy + 1) * tileSize.height + bandSize, imageSize.height);
+
+				const double pixelCost = (double)(x2 - x1) * (y2 - y1) * mixtureCount * getMemoryFactor(x2 - x1, y2 - y1, tileCount);
+
+				totalCost += fitCost + pixelCost;
+				largestPixelCost = max(largestPixelCost, pixelCost);
+			}
+		}
+
+		// tasks split the pixels of a tile over the threads, a fit is never split, otherwise tiles are dealt out in rounds and the threads left over
+		// by the tiles work inside the tiles
+		if (taskScheduling) {
+			return max(totalCost / threadCount, fitCost + largestPixelCost / threadCount);
+		}
+
+		const int roundCount = (tileCount + threadCount - 1) / threadCount;
+		const int intraTileThreadCount = max(threadCount / tileCount, 1);
+
+		return roundCount * (fitCost + (totalCost / tileCount - fitCost) / intraTileThreadCount);
+	}
+
+	const CacheHierarchy& getCacheHierarchy() const
+	{
+		return cacheHierarchy;
+	}
+
+private:
+	CacheHierarchy cacheHierarchy;
+	int threadCount;
+	int mixtureCount;
+	int bandSize;
+	bool taskScheduling;
+	int sweptRowCount;
+	int integralImageBytesPerPixel;
+	int tileBytesPerPixel;
+	double fitPixelEquivalent;
+	double level2Penalty;
+	double level3Penalty;
+	int minimumTilePixelCount;
+	int maximumTilePixelCount;
+	double concurrentMemoryBudget;
+
+	// bytes of the tiles processed at the same time (a thread per tile, each holding its expanded tile)
+	double getConcurrentBytes(Size imageSize, Size tileSize) const
+	{
+		const int tileCount = ((imageSize.width + tileSize.width - 1) / tileSize.width) * ((imageSize.height + tileSize.height - 1) / tileSize.height);
+		const int expandedWidth = min(tileSize.width + 2 * bandSize, imageSize.width);
+		const int expandedHeight = min(tileSize.height + 2 * bandSize, imageSize.height);
+
+		return (double)min(threadCount, tileCount) * expandedWidth * expandedHeight * tileBytesPerPixel;
+	}
+
+	double getMemoryFactor(int expandedWidth, int expandedHeight, int tileCount) const
+	{
+		const double sweptBytes = (double)sweptRowCount * expandedWidth * integralImageBytesPerPixel;
+		const double concurrentBytes = (double)min(threadCount, tileCount) * expandedWidth * expandedHeight * tileBytesPerPixel;
+
+		return (1.0 + (sweptBytes > cacheHierarchy.level2Size ? level2Penalty : 0.0) + (concurrentBytes > cacheHierarchy.level3Size ? level3Penalty : 0.0));
+	}
+
+};
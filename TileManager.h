@@ -1,21 +1,46 @@
 #pragma once
 
+#include <omp.h>
+#include <algorithm>
 #include <opencv2\opencv.hpp>
 
 using namespace cv;
 using namespace std;
 
 
+// cheap a priori estimate of the processing cost of a tile from a sparse pixel sample
+struct TileCostEstimate {
+	double validPixelCount;			// pixels >= 1 (extrapolated from the sample)
+	double spread;					// log(p99 / p50) of the valid pixels, about 0.95 for a single Rayleigh
+	int predictedMixtureCount;		// spread in units of the single Rayleigh spread
+	double cost;					// relative units, see estimateTileCosts
+
+	TileCostEstimate()
+	{
+		validPixelCount = 0.0;
+		spread = 0.0;
+		predictedMixtureCount = 0;
+		cost = 0.0;
+	}
+};
+
 class TileManager {
 public:
-	TileManager(Mat& image, int tileSize = 512, int bandSize = 16, int targetImageType = -1)
+	// a negative targetImageType allocates a result image of the input type, no result image is allocated if allocateResultImage is not set (sparse outputs)
+	TileManager(Mat& image, int tileSize = 512, int bandSize = 16, int targetImageType = -1, bool allocateResultImage = true)
+		: TileManager(image, Size(tileSize, tileSize), bandSize, targetImageType, allocateResultImage)
+	{
+	}
+
+	// rectangular tiles, e.g. full-width strips (see TileGeometryPlanner)
+	TileManager(Mat& image, Size tileSize, int bandSize = 16, int targetImageType = -1, bool allocateResultImage = true)
 	{
 		this->image = image;
 		this->tileSize = tileSize;
 		this->bandSize = bandSize;
 
-		const int cellXcount = max((image.cols + tileSize - 1) / tileSize, 1);
-		const int cellYcount = max((image.rows + tileSize - 1) / tileSize, 1);
+		cellXcount = max((image.cols + tileSize.width - 1) / tileSize.width, 1);
+		cellYcount = max((image.rows + tileSize.height - 1) / tileSize.height, 1);
 
 		for (int yy=0; yy<cellYcount; yy++) {
 			for (int xx=0; xx<cellXcount; xx++) {
@@ -27,7 +52,9 @@ public:
 			targetImageType = image.type();
 		}
 
-		resultImage = Mat(image.rows, image.cols, targetImageType, Scalar(0));
+		if (allocateResultImage) {
+			resultImage = Mat(image.rows, image.cols, targetImageType, Scalar(0));
+		}
 	}
 
 	Mat getimage() const
@@ -35,7 +62,7 @@ public:
 		return image;
 	}
 
-	int getTileSize() const 
+	Size getTileSize() const
 	{
 		return tileSize;
 	}
@@ -50,87 +77,155 @@ public:
 		return tileIndices;
 	}
 
-	Mat getInputTile(pair<int, int> tileIndex) const
+	// Quadtree tiling by clutter homogeneity, aligned 2x2 blocks of tiles are merged bottom-up into tiles of up to maximumSpan cells per side as long as
+	// the log median and the log(p90 / p50) spread of the merged tiles (sample weighted means of their cells) vary by at most tolerance. Homogeneous
+	// clutter then costs a single mixture fit per large tile, while heterogeneous clutter keeps the small cells. Tiles without data fit any clutter. The
+	// tiles keep the raster order of their top-left cells, whose indices they take (getSeedTileNumber and getAnchorTiles need the regular grid).
+	void mergeHomogeneousCells(int maximumSpan, double tolerance, int sampleStep = 4)
 	{
-		const int tileXindex = tileIndex.first;
-		const int tileYindex = tileIndex.second;
+		const int cellCount = cellXcount * cellYcount;
+
+		// about a thousand samples per cell, the upper percentile of fewer samples varies too much between cells of the same clutter
+		sampleStep = max(min(sampleStep, min(tileSize.width, tileSize.height) / 32), 1);
+
+		// log median, spread and sample count of the tile at a cell
+		vector<Vec3d> clutterStatistics(cellCount);
+
+		int i;
+		#pragma omp parallel for private(i) schedule(dynamic, 1)
+		for (i = 0; i < cellCount; i++) {
+			Mat cell = image(getCellRectangle(pair<int, int>(i % cellXcount, i / cellXcount)));
+			vector<double> samples = sampleValidPixels(cell, sampleStep);
+
+			clutterStatistics[i] = Vec3d(0.0, 0.0, 0.0);
+			if (!samples.empty()) {
+				const double medianValue = getPercentile(samples, 0.50);
+				const double upperValue = getPercentile(samples, 0.90);
 
-		const int x1 = (tileXindex * tileSize);
-		const int y1 = (tileYindex * tileSize);
-		const int x2 = min(x1 + tileSize, image.cols);
-		const int y2 = min(y1 + tileSize, image.rows);
+				clutterStatistics[i] = Vec3d(log(medianValue), log(upperValue / medianValue), (double)samples.size());
+			}
+		}
+
+		cellSpans.assign(cellCount, 1);
+		for (int span = 2; span <= maximumSpan; span *= 2) {
+			const int half = span / 2;
+
+			for (int yy = 0; yy < cellYcount; yy += span) {
+				for (int xx = 0; xx < cellXcount; xx += span) {
+					double medianMinimum = DBL_MAX, medianMaximum = -DBL_MAX, spreadMinimum = DBL_MAX, spreadMaximum = -DBL_MAX;
+					double medianSum = 0.0, spreadSum = 0.0, sampleCount = 0.0;
+					bool isMergeable = true;
+
+					for (int y = yy; y < min(yy + span, cellYcount); y += half) {
+						for (int x = xx; x < min(xx + span, cellXcount); x += half) {
+							const Vec3d& statistics = clutterStatistics[y * cellXcount + x];
+
+							isMergeable = (isMergeable && cellSpans[y * cellXcount + x] == half);
+							if (statistics[2] > 0.0) {
+								medianMinimum = min(medianMinimum, statistics[0]);
+								medianMaximum = max(medianMaximum, statistics[0]);
+								spreadMinimum = min(spreadMinimum, statistics[1]);
+								spreadMaximum = max(spreadMaximum, statistics[1]);
+								medianSum += statistics[2] * statistics[0];
+								spreadSum += statistics[2] * statistics[1];
+								sampleCount += statistics[2];
+							}
+						}
+					}
 
-		const int x1e = max(x1 - bandSize, 0);
-		const int y1e = max(y1 - bandSize, 0);
-		const int x2e = min(x2 + bandSize, image.cols);
-		const int y2e = min(y2 + bandSize, image.rows);
+					if (isMergeable && (sampleCount == 0.0 || (medianMaximum - medianMinimum <= tolerance && spreadMaximum - spreadMinimum <= tolerance))) {
+						for (int y = yy; y < min(yy + span, cellYcount); y += half) {
+							for (int x = xx; x < min(xx + span, cellXcount); x += half) {
+								cellSpans[y * cellXcount + x] = 0;
+							}
+						}
 
-		Mat inputTile = image(Range(y1e, y2e), Range(x1e, x2e));
+						cellSpans[yy * cellXcount + xx] = span;
+						clutterStatistics[yy * cellXcount + xx] = (sampleCount > 0.0 ? Vec3d(medianSum / sampleCount, spreadSum / sampleCount, sampleCount) : Vec3d(0.0, 0.0, 0.0));
+					}
+				}
+			}
+		}
 
-		return inputTile;
+		tileIndices.clear();
+		for (int yy = 0; yy < cellYcount; yy++) {
+			for (int xx = 0; xx < cellXcount; xx++) {
+				if (cellSpans[yy * cellXcount + xx] > 0) {
+					tileIndices.push_back(pair<int, int>(xx, yy));
+				}
+			}
+		}
 	}
 
-	Rect getTileWorkingRectangle(pair<int, int> tileIndex)
+	// side of the largest tile in pixels
+	Size getLargestTileSize() const
 	{
-		const int tileXindex = tileIndex.first;
-		const int tileYindex = tileIndex.second;
+		const int maximumSpan = (cellSpans.empty() ? 1 : *max_element(cellSpans.begin(), cellSpans.end()));
 
-		const int x1 = (tileXindex * tileSize);
-		const int y1 = (tileYindex * tileSize);
-		const int x2 = min(x1 + tileSize, image.cols);
-		const int y2 = min(y1 + tileSize, image.rows);
-
-		const int x1e = max(x1 - bandSize, 0);
-		const int y1e = max(y1 - bandSize, 0);
-		const int x2e = min(x2 + bandSize, image.cols);
-		const int y2e = min(y2 + bandSize, image.rows);
+		return Size(min(tileSize.width * maximumSpan, image.cols), min(tileSize.height * maximumSpan, image.rows));
+	}
 
-		return Rect(x1 - x1e, y1 - y1e, x2 - x1, y2 - y1);
+	// Occupancy index, bounding box of the non-zero pixels of every tile cell (tileSize without bands, in the order of getTileIndices, image
+	// coordinates), an empty rectangle marks a cell without data. Input tiles are cropped to the data of the cells they overlap, so everything cropped away
+	// is zero (see getNoDataPixelCount), and tiles without data in their working rectangle are empty (see isTileEmpty).
+	void setOccupancyIndex(const vector<Rect>& cellDataRectangles)
+	{
+		this->cellDataRectangles = cellDataRectangles;
 	}
 
-	template<typename T>
-	void assignResultTile(pair<int, int> tileIndex, Mat& resultTile)
+	Mat getInputTile(pair<int, int> tileIndex) const
 	{
-		const int tileXindex = tileIndex.first;
-		const int tileYindex = tileIndex.second;
+		return image(getInputTileRectangle(tileIndex));
+	}
 
-		const int x1 = (tileXindex * tileSize);
-		const int y1 = (tileYindex * tileSize);
-		const int x2 = min(x1 + tileSize, image.cols);
-		const int y2 = min(y1 + tileSize, image.rows);
+	// image coordinates of the top-left pixel of the input tile (tile coordinates + origin = image coordinates)
+	Point getInputTileOrigin(pair<int, int> tileIndex) const
+	{
+		return getInputTileRectangle(tileIndex).tl();
+	}
 
-		const int x1e = max(x1 - bandSize, 0);
-		const int y1e = max(y1 - bandSize, 0);
-		const int x2e = min(x2 + bandSize, image.cols);
-		const int y2e = min(y2 + bandSize, image.rows);
+	Rect getTileWorkingRectangle(pair<int, int> tileIndex) const
+	{
+		const Rect inputRect = getInputTileRectangle(tileIndex);
+		const Rect workingRect = getCellRectangle(tileIndex) & inputRect;
 
-		const int width = (x2 - x1);
-		const int height = (y2 - y1);
+		return Rect(workingRect.x - inputRect.x, workingRect.y - inputRect.y, workingRect.width, workingRect.height);
+	}
 
-		const int expandedWidth = (x2e - x1e);
+	// the results of an empty tile are those of a tile without data pixels, so it does not need to be processed
+	bool isTileEmpty(pair<int, int> tileIndex) const
+	{
+		return (!cellDataRectangles.empty() && (getCellRectangle(tileIndex) & getDataRectangle(tileIndex)).area() == 0);
+	}
 
-		for (int y=0; y<height; y++) {
-			T* srow = (T*)(resultTile.data + (y + y1 - y1e) * resultTile.step) + (x1 - x1e);
-			T* trow = (T*)(resultImage.data + (y + y1) * resultImage.step) + x1;
+	// zero pixels of the expanded tile cropped away by the occupancy index
+	int getNoDataPixelCount(pair<int, int> tileIndex) const
+	{
+		return (getExpandedTileRectangle(tileIndex).area() - getInputTileRectangle(tileIndex).area());
+	}
 
-			for (int  x=0; x<width; x++) {
-				trow[x] = srow[x];
-			}
+	// View of the result image with the geometry of the input tile (tile coordinates), empty if no result image is allocated (sparse outputs). The
+	// detector writes only into the working rectangle, so the results land in place and tiles processed concurrently never write the same pixels.
+	Mat getResultTile(pair<int, int> tileIndex) const
+	{
+		if (resultImage.empty()) {
+			return Mat();
 		}
+
+		return resultImage(getInputTileRectangle(tileIndex));
 	}
 
+	// copies the working rectangle of a separately allocated result tile, views returned by getResultTile are already in place
 	void setResultTile(pair<int, int> tileIndex, Mat& resultTile)
 	{
-		switch (resultImage.type())
-		{
-		case CV_8U:  assignResultTile<unsigned char>(tileIndex, resultTile);	break;
-		case CV_8S:  assignResultTile<char>(tileIndex, resultTile);				break;
-		case CV_16U: assignResultTile<unsigned short>(tileIndex, resultTile);	break;
-		case CV_16S: assignResultTile<short>(tileIndex, resultTile);			break;
-		case CV_32S: assignResultTile<int>(tileIndex, resultTile);				break;
-		case CV_32F: assignResultTile<float>(tileIndex, resultTile);			break;
-		case CV_64F: assignResultTile<double>(tileIndex, resultTile);			break;
+		if (resultImage.empty() || resultTile.datastart == resultImage.datastart) {
+			return;
 		}
+
+		const Rect workingRect = getTileWorkingRectangle(tileIndex);
+		Mat resultRegion = resultImage(workingRect + getInputTileOrigin(tileIndex));
+
+		resultTile(workingRect).copyTo(resultRegion);
 	}
 
 	Mat getResultImage() const
@@ -138,6 +233,134 @@ public:
 		return resultImage;
 	}
 
+	// value of the result pixels outside of the working rectangles written by the tiles (cropped or empty tiles)
+	void fillResultImage(double value)
+	{
+		if (!resultImage.empty()) {
+			resultImage = Scalar(value);
+		}
+	}
+
+	// bounding box of the non-zero pixels of the image region in image coordinates (empty if there are none), the full region if there are negative
+	// pixels, as those are shifted to valid data by the tile refinement
+	static Rect findDataRectangle(Mat& image, Rect region)
+	{
+		Mat imageRegion = image(region);
+
+		switch (image.type())
+		{
+		case CV_8U:  return findDataRectangle<unsigned char>(imageRegion) + region.tl();
+		case CV_8S:  return findDataRectangle<char>(imageRegion) + region.tl();
+		case CV_16U: return findDataRectangle<unsigned short>(imageRegion) + region.tl();
+		case CV_16S: return findDataRectangle<short>(imageRegion) + region.tl();
+		case CV_32S: return findDataRectangle<int>(imageRegion) + region.tl();
+		default: return region;
+		}
+	}
+
+	// Cost of each input tile (in the order of getTileIndices) from every sampleStep-th pixel in both directions. A tile with data costs a mixture fit,
+	// whose annealing iterations grow with maximumMixtureCount and which is counted as fitPixelEquivalent pixels per mixture, plus the detection
+	// of its valid pixels, whose SAT accesses grow with the number of intervals (predicted mixture count).
+	vector<TileCostEstimate> estimateTileCosts(int maximumMixtureCount, int sampleStep = 4, double fitPixelEquivalent = 16384.0) const
+	{
+		const double singleRayleighSpread = 0.5 * log(log(100.0) / log(2.0));
+
+		vector<TileCostEstimate> costEstimates(tileIndices.size());
+
+		int i;
+		#pragma omp parallel for private(i) schedule(dynamic, 1)
+		for (i = 0; i < (int)tileIndices.size(); i++) {
+			Mat inputTile = getInputTile(tileIndices[i]);
+			vector<double> samples = sampleValidPixels(inputTile, sampleStep);
+
+			TileCostEstimate& costEstimate = costEstimates[i];
+			costEstimate.validPixelCount = (double)samples.size() * sampleStep * sampleStep;
+
+			if (!samples.empty()) {
+				const double medianValue = getPercentile(samples, 0.50);
+				const double upperValue = getPercentile(samples, 0.99);
+
+				costEstimate.spread = log(upperValue / medianValue);
+				costEstimate.predictedMixtureCount = max(1, min(maximumMixtureCount, (int)floor(costEstimate.spread / singleRayleighSpread + 0.5)));
+				costEstimate.cost = fitPixelEquivalent * maximumMixtureCount + costEstimate.validPixelCount * costEstimate.predictedMixtureCount;
+			}
+		}
+
+		return costEstimates;
+	}
+
+	// positions in getTileIndices() by decreasing cost, equal costs keep raster order
+	static vector<int> getTileOrder(const vector<TileCostEstimate>& costEstimates)
+	{
+		vector<int> tileOrder(costEstimates.size());
+		for (int i = 0; i < tileOrder.size(); i++) {
+			tileOrder[i] = i;
+		}
+
+		stable_sort(tileOrder.begin(), tileOrder.end(), [&costEstimates](int i1, int i2) { return costEstimates[i1].cost > costEstimates[i2].cost; });
+
+		return tileOrder;
+	}
+
+	// Seed of a warm-started mixture fit (position in getTileIndices(), -1 for a fit from scratch). The tile grid is split into blocks of
+	// (2 * radius + 1)^2 tiles, the centre tile of a block is fitted from scratch and every other tile is seeded by its neighbour one step closer
+	// to the centre, so the seeds are fixed by the geometry and a fit only waits for the fits of its own block. level : steps to the centre.
+	int getSeedTileNumber(int tileNumber, int radius, int* level = NULL) const
+	{
+		radius = max(radius, 0);
+		const int blockSize = 2 * radius + 1;
+		CV_Assert(cellSpans.empty());
+		const pair<int, int> tileIndex = tileIndices[tileNumber];
+
+		// the centres of the blocks at the right and bottom are clamped to the grid
+		const int centreX = min(tileIndex.first / blockSize * blockSize + radius, cellXcount - 1);
+		const int centreY = min(tileIndex.second / blockSize * blockSize + radius, cellYcount - 1);
+		const int dx = tileIndex.first - centreX;
+		const int dy = tileIndex.second - centreY;
+
+		if (level != NULL) {
+			*level = max(abs(dx), abs(dy));
+		}
+
+		if (dx == 0 && dy == 0) {
+			return -1;
+		}
+
+		const int seedX = tileIndex.first - (dx > 0 ? 1 : (dx < 0 ? -1 : 0));
+		const int seedY = tileIndex.second - (dy > 0 ? 1 : (dy < 0 ? -1 : 0));
+
+		return seedY * cellXcount + seedX;
+	}
+
+	// Anchor tiles of a sparse fit grid (every spacing-th tile cell in both directions, plus the last column and row) around a tile with the bilinear
+	// weights of the tile between them (positions in getTileIndices(), an anchor tile is its own single anchor)
+	void getAnchorTiles(int tileNumber, int spacing, vector<int>& anchorTiles, vector<double>& anchorWeights) const
+	{
+		spacing = max(spacing, 1);
+		CV_Assert(cellSpans.empty());
+		const pair<int, int> tileIndex = tileIndices[tileNumber];
+
+		const int anchorX[2] = { tileIndex.first / spacing * spacing, min(tileIndex.first / spacing * spacing + spacing, cellXcount - 1) };
+		const int anchorY[2] = { tileIndex.second / spacing * spacing, min(tileIndex.second / spacing * spacing + spacing, cellYcount - 1) };
+		const double wx = (anchorX[1] > anchorX[0] ? (double)(tileIndex.first - anchorX[0]) / (anchorX[1] - anchorX[0]) : 0.0);
+		const double wy = (anchorY[1] > anchorY[0] ? (double)(tileIndex.second - anchorY[0]) / (anchorY[1] - anchorY[0]) : 0.0);
+		const double weightX[2] = { 1.0 - wx, wx };
+		const double weightY[2] = { 1.0 - wy, wy };
+
+		anchorTiles.clear();
+		anchorWeights.clear();
+		for (int j = 0; j < 2; j++) {
+			for (int i = 0; i < 2; i++) {
+				const double weight = weightX[i] * weightY[j];
+
+				if (weight > 0.0) {
+					anchorTiles.push_back(anchorY[j] * cellXcount + anchorX[i]);
+					anchorWeights.push_back(weight);
+				}
+			}
+		}
+	}
+
 	static Rect findBoundingBox(Mat& image)
 	{
 		switch (image.type())
@@ -207,10 +430,140 @@ public:
 
 private:
 	Mat image;
-	int tileSize;
+	Size tileSize;
 	int bandSize;
+	int cellXcount;
+	int cellYcount;
 
 	vector<pair<int, int>> tileIndices;
+	vector<int> cellSpans;				// cells per side of the tile at a cell, 0 inside merged tiles (empty for the regular grid)
+	vector<Rect> cellDataRectangles;
 	Mat resultImage;
 
+	Rect getCellRectangle(pair<int, int> tileIndex) const
+	{
+		const int span = (cellSpans.empty() ? 1 : cellSpans[tileIndex.second * cellXcount + tileIndex.first]);
+
+		const int x1 = (tileIndex.first * tileSize.width);
+		const int y1 = (tileIndex.second * tileSize.height);
+		const int x2 = min(x1 + span * tileSize.width, image.cols);
+		const int y2 = min(y1 + span * tileSize.height, image.rows);
+
+		return Rect(x1, y1, x2 - x1, y2 - y1);
+	}
+
+	// cell extended by the band on each side
+	Rect getExpandedTileRectangle(pair<int, int> tileIndex) const
+	{
+		const Rect cellRect = getCellRectangle(tileIndex);
+
+		const int x1e = max(cellRect.x - bandSize, 0);
+		const int y1e = max(cellRect.y - bandSize, 0);
+		const int x2e = min(cellRect.x + cellRect.width + bandSize, image.cols);
+		const int y2e = min(cellRect.y + cellRect.height + bandSize, image.rows);
+
+		return Rect(x1e, y1e, x2e - x1e, y2e - y1e);
+	}
+
+	// expanded tile cropped to the data of the overlapped cells, with a margin of one pixel, so the 3x3 median filter of the censoring sees the
+	// same zeros at the crop border as in the full tile
+	Rect getInputTileRectangle(pair<int, int> tileIndex) const
+	{
+		const Rect expandedRect = getExpandedTileRectangle(tileIndex);
+		if (cellDataRectangles.empty()) {
+			return expandedRect;
+		}
+
+		const Rect dataRect = getDataRectangle(tileIndex);
+		if (dataRect.area() == 0) {
+			return Rect(expandedRect.x, expandedRect.y, 0, 0);
+		}
+
+		return Rect(dataRect.x - 1, dataRect.y - 1, dataRect.width + 2, dataRect.height + 2) & expandedRect;
+	}
+
+	// bounding box of the data of the cells overlapped by the expanded tile (the band may reach over several cells narrower than the band)
+	Rect getDataRectangle(pair<int, int> tileIndex) const
+	{
+		const Rect expandedRect = getExpandedTileRectangle(tileIndex);
+
+		const int cellX1 = expandedRect.x / tileSize.width;
+		const int cellY1 = expandedRect.y / tileSize.height;
+		const int cellX2 = min((expandedRect.x + expandedRect.width - 1) / tileSize.width, cellXcount - 1);
+		const int cellY2 = min((expandedRect.y + expandedRect.height - 1) / tileSize.height, cellYcount - 1);
+
+		int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+		for (int yy = cellY1; yy <= cellY2; yy++) {
+			for (int xx = cellX1; xx <= cellX2; xx++) {
+				const Rect dataRect = cellDataRectangles[yy * cellXcount + xx] & expandedRect;
+
+				if (dataRect.area() > 0) {
+					x1 = min(x1, dataRect.x);
+					y1 = min(y1, dataRect.y);
+					x2 = max(x2, dataRect.x + dataRect.width);
+					y2 = max(y2, dataRect.y + dataRect.height);
+				}
+			}
+		}
+
+		return (x1 > x2 ? Rect() : Rect(x1, y1, x2 - x1, y2 - y1));
+	}
+
+	template<typename T>
+	static Rect findDataRectangle(Mat& image)
+	{
+		int x1 = image.cols;
+		int x2 = -1;
+		int y1 = image.rows;
+		int y2 = -1;
+
+		for (int y = 0; y < image.rows; y++) {
+			T* irow = (T*)(image.data + y * image.step);
+
+			for (int x = 0; x < image.cols; x++) {
+				if (irow[x] < 0) {
+					return Rect(0, 0, image.cols, image.rows);
+				}
+
+				if (irow[x] != 0) {
+					x1 = min(x1, x);
+					x2 = max(x2, x);
+					y1 = min(y1, y);
+					y2 = max(y2, y);
+				}
+			}
+		}
+
+		return (x2 < 0 ? Rect() : Rect(x1, y1, x2 - x1 + 1, y2 - y1 + 1));
+	}
+
+	static vector<double> sampleValidPixels(Mat& tile, int sampleStep)
+	{
+		vector<double> samples;
+		samples.reserve((tile.rows / sampleStep + 1) * (tile.cols / sampleStep + 1));
+
+		Mat row;
+		for (int y = 0; y < tile.rows; y += sampleStep) {
+			tile.row(y).convertTo(row, CV_64F);
+			const double* srow = (double*)row.data;
+
+			for (int x = 0; x < tile.cols; x += sampleStep) {
+				if (srow[x] >= 1.0) {
+					samples.push_back(srow[x]);
+				}
+			}
+		}
+
+		return samples;
+	}
+
+	// partially sorts samples
+	static double getPercentile(vector<double>& samples, double percentile)
+	{
+		vector<double>::iterator nth = samples.begin() + (size_t)(percentile * (samples.size() - 1));
+		nth_element(samples.begin(), nth, samples.end());
+
+		return *nth;
+	}
+
 };
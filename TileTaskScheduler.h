@@ -0,0 +1,232 @@
+#pragma once
+
+#include <omp.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+
+// one stage of one tile, part is the row band or column strip of stages that are split into subtasks
+struct TileTask {
+	int stage;
+	int tileNumber;
+	int part;
+
+	TileTask(int stage = 0, int tileNumber = 0, int part = 0)
+	{
+		this->stage = stage;
+		this->tileNumber = tileNumber;
+		this->part = part;
+	}
+};
+
+// Work-stealing scheduler for the threads of an OpenMP parallel region (OpenMP 2.0, so no omp tasks). Every thread owns a task queue, it takes
+// its newest task (depth-first, the data of the tile it just worked on is still in cache), then the oldest task of the shared queue (new tiles in
+// the order they are pushed) and steals the oldest task of another thread when both are empty. Tasks may push follow-up tasks, getTask returns
+// false once every pushed task is completed. Threads without a task sleep until a task is pushed, so they leave the cores to the nested regions of
+// the running tasks (a single chip censors with all threads while the others wait for its SAT tasks).
+class TileTaskScheduler {
+public:
+	TileTaskScheduler(int threadCount)
+	{
+		this->threadCount = max(threadCount, 1);
+		pendingTaskCount = 0;
+		eventCount = 0;
+		sleepingThreadCount = 0;
+
+		queues.resize(this->threadCount);
+		queueLocks.resize(this->threadCount);
+		for (int i = 0; i < this->threadCount; i++) {
+			omp_init_lock(&queueLocks[i]);
+		}
+		omp_init_lock(&sharedQueueLock);
+		omp_init_lock(&counterLock);
+	}
+
+	virtual ~TileTaskScheduler()
+	{
+		for (int i = 0; i < threadCount; i++) {
+			omp_destroy_lock(&queueLocks[i]);
+		}
+		omp_destroy_lock(&sharedQueueLock);
+		omp_destroy_lock(&counterLock);
+	}
+
+	int getThreadCount() const
+	{
+		return threadCount;
+	}
+
+	// called before the parallel region (any threadNumber) or by a running task (its own threadNumber)
+	void push(int threadNumber, const TileTask& task)
+	{
+		omp_set_lock(&counterLock);
+		pendingTaskCount++;
+		omp_unset_lock(&counterLock);
+
+		omp_set_lock(&queueLocks[threadNumber]);
+		queues[threadNumber].push_back(task);
+		omp_unset_lock(&queueLocks[threadNumber]);
+
+		signal(false);
+	}
+
+	// tasks of the shared queue are taken in push order by whichever thread runs out of own tasks first
+	void pushShared(const TileTask& task)
+	{
+		omp_set_lock(&counterLock);
+		pendingTaskCount++;
+		omp_unset_lock(&counterLock);
+
+		omp_set_lock(&sharedQueueLock);
+		sharedQueue.push_back(task);
+		omp_unset_lock(&sharedQueueLock);
+
+		signal(false);
+	}
+
+	// waits for a task of the own queue or of another thread, false if all tasks are completed
+	bool getTask(int threadNumber, TileTask& task)
+	{
+		while (true) {
+			// a push after this point changes the event count, so the queues found empty below are only slept on if nothing was pushed since
+			unique_lock<mutex> eventLock(eventMutex);
+			const long long seenEventCount = eventCount;
+			eventLock.unlock();
+
+			if (popOwnTask(threadNumber, task) || popSharedTask(task) || stealTask(threadNumber, task)) {
+				return true;
+			}
+
+			if (isFinished()) {
+				return false;
+			}
+
+			eventLock.lock();
+			sleepingThreadCount++;
+			eventCondition.wait(eventLock, [&] { return eventCount != seenEventCount; });
+			sleepingThreadCount--;
+		}
+	}
+
+	// to be called after a task returned by getTask is executed (and its follow-up tasks are pushed)
+	void completeTask()
+	{
+		omp_set_lock(&counterLock);
+		const bool isLast = (--pendingTaskCount == 0);
+		omp_unset_lock(&counterLock);
+
+		// the sleeping threads return false
+		if (isLast) {
+			signal(true);
+		}
+	}
+
+	// counts down the subtasks of a split stage, true for the subtask that completes the stage
+	bool completeSubtask(int& remainingSubtaskCount)
+	{
+		omp_set_lock(&counterLock);
+		const bool isLast = (--remainingSubtaskCount == 0);
+		omp_unset_lock(&counterLock);
+
+		return isLast;
+	}
+
+private:
+	int threadCount;
+	vector<deque<TileTask>> queues;
+	vector<omp_lock_t> queueLocks;
+	deque<TileTask> sharedQueue;
+	omp_lock_t sharedQueueLock;
+	omp_lock_t counterLock;
+	int pendingTaskCount;
+	mutex eventMutex;
+	condition_variable eventCondition;
+	long long eventCount;
+	int sleepingThreadCount;
+
+	// a pushed task wakes one sleeping thread, the completion of all tasks wakes every thread
+	void signal(bool isCompleted)
+	{
+		{
+			lock_guard<mutex> eventLock(eventMutex);
+			eventCount++;
+
+			if (sleepingThreadCount == 0) {
+				return;
+			}
+		}
+
+		if (isCompleted) {
+			eventCondition.notify_all();
+		}
+		else {
+			eventCondition.notify_one();
+		}
+	}
+
+	bool popOwnTask(int threadNumber, TileTask& task)
+	{
+		bool isFound = false;
+
+		omp_set_lock(&queueLocks[threadNumber]);
+		if (!queues[threadNumber].empty()) {
+			task = queues[threadNumber].back();
+			queues[threadNumber].pop_back();
+			isFound = true;
+		}
+		omp_unset_lock(&queueLocks[threadNumber]);
+
+		return isFound;
+	}
+
+	bool popSharedTask(TileTask& task)
+	{
+		bool isFound = false;
+
+		omp_set_lock(&sharedQueueLock);
+		if (!sharedQueue.empty()) {
+			task = sharedQueue.front();
+			sharedQueue.pop_front();
+			isFound = true;
+		}
+		omp_unset_lock(&sharedQueueLock);
+
+		return isFound;
+	}
+
+	bool stealTask(int threadNumber, TileTask& task)
+	{
+		for (int i = 1; i < threadCount; i++) {
+			const int victim = (threadNumber + i) % threadCount;
+
+			bool isFound = false;
+
+			omp_set_lock(&queueLocks[victim]);
+			if (!queues[victim].empty()) {
+				task = queues[victim].front();
+				queues[victim].pop_front();
+				isFound = true;
+			}
+			omp_unset_lock(&queueLocks[victim]);
+
+			if (isFound) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool isFinished()
+	{
+		omp_set_lock(&counterLock);
+		const bool isFinished = (pendingTaskCount == 0);
+		omp_unset_lock(&counterLock);
+
+		return isFinished;
+	}
+
+};
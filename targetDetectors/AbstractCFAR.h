@@ -2,6 +2,7 @@
 
 #include <omp.h>
 #include <opencv2\opencv.hpp>
+#include "TargetDetectionList.h"
 
 using namespace cv;
 using namespace std;
@@ -22,6 +23,30 @@ public:
 
 	virtual Mat execute(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters) = 0;
 
+	// per-pixel false alarm probability (CV_32F) that does not depend on Pfa, a pixel is a target at Pfa if its value is below Pfa
+	// (see applyProbabilityOfFalseAlarm), an empty map is returned by detectors that do not support it
+	virtual Mat executeProbabilityMap(Mat image, map<string, double>& parameters)
+	{
+		return Mat();
+	}
+
+	// target map (CV_8U) of a probability map at the given Pfa
+	static Mat applyProbabilityOfFalseAlarm(Mat& probabilityMap, double probabilityOfFalseAlarm)
+	{
+		Mat targetMap;
+		compare(probabilityMap, Scalar(probabilityOfFalseAlarm), targetMap, CMP_LT);
+
+		return targetMap;
+	}
+
+	// target pixels as a sparse list (raster order) instead of a full-size target map, the default extracts them from the target map
+	virtual vector<TargetDetection> executeDetectionList(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters)
+	{
+		Mat targetMap = execute(image, probabilityOfFalseAlarm, parameters);
+
+		return TargetDetectionList::createFromTargetMap(targetMap, image);
+	}
+
 	virtual int getClutterArea(map<string, double>& parameters) = 0;
 
 	virtual int getBandWidth(map<string, double>& parameters) = 0;
@@ -30,6 +55,9 @@ public:
 
 	virtual bool requiresGlobalHistogram() const { return false; }
 
+	// detectors that keep data between execute calls (e.g. to evaluate many Pfa values on the same image) release it here
+	virtual void releaseCache() {}
+
 	double getParameterValue(map<string, double>& parameters, string key, double defaultValue)
 	{
 		if (parameters.find(key) == parameters.end())
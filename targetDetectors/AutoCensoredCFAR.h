@@ -39,6 +39,23 @@ protected:
 		
 		return result;
 	}
+
+	virtual bool supportsFalseAlarmProbability() const { return true; }
+
+	virtual double calculateFalseAlarmProbability(Detector* detector, double* candidateRegion, const int& numCandidatePixels, double* clutterRegion, const int& numClutterPixels, const int& numRegion1, const int& numRegion2, const int& numRegion3, const int& numRegion4)
+	{
+		double meanVal = 0.0;
+		for(int i=0; i<numCandidatePixels; i++)
+		{
+			meanVal += candidateRegion[i];
+		}
+		meanVal /= numCandidatePixels;
+
+		int numClutterPixelsToUseInThresholdEst = (int)(numClutterPixels * osPercent / 100.0 + 0.5);
+		quickSelect<double>(clutterRegion, numClutterPixels, numClutterPixelsToUseInThresholdEst);
+
+		return detector->calculateFalseAlarmProbability(meanVal, clutterRegion, numClutterPixelsToUseInThresholdEst);
+	}
 private:
 
 };
@@ -35,4 +35,18 @@ protected:
 		
 		return result;
 	}
+
+	virtual bool supportsFalseAlarmProbability() const { return true; }
+
+	virtual double calculateFalseAlarmProbability(Detector* detector, double* candidateRegion, const int& numCandidatePixels, double* clutterRegion, const int& numClutterPixels, const int& numRegion1, const int& numRegion2, const int& numRegion3, const int& numRegion4)
+	{
+		double meanVal = 0.0;
+		for(int i=0; i<numCandidatePixels; i++)
+		{
+			meanVal += candidateRegion[i];
+		}
+		meanVal /= numCandidatePixels;
+
+		return detector->calculateFalseAlarmProbability(meanVal, clutterRegion, numClutterPixels);
+	}
 };
@@ -12,6 +12,17 @@ public:
 		return testValue(valueToTest, threshold);
 	}
 
+	// true if the distribution provides estimateTailProbability
+	virtual bool supportsFalseAlarmProbability() const { return false; }
+
+	// probability of a clutter value above valueToTest, negative if the distribution does not provide it
+	virtual double calculateFalseAlarmProbability(const double valueToTest, double* clutterValues, const int numberOfClutterValues)
+	{
+		estimatePdfParameters(clutterValues, numberOfClutterValues);
+
+		return estimateTailProbability(valueToTest);
+	}
+
 	inline void clearData()
 	{
 		if (data != NULL) {
@@ -41,6 +52,11 @@ protected:
 	
 	virtual double estimateThreshold(const double probabilityOfFalseAlarm) = NULL;
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return -1.0;
+	}
+
 	virtual bool testValue(const double valueToTest, const double threshold)
 	{
 		return (valueToTest > threshold);
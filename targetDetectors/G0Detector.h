@@ -9,6 +9,7 @@ using namespace std;
 
 class G0Detector : public Detector {
 public:
+	virtual bool supportsFalseAlarmProbability() const { return true; }
 
 protected:
 	virtual void estimatePdfParameters(double* clutterValues, const int numberOfClutterValues)
@@ -34,6 +35,11 @@ protected:
 		return gamma*(pow(probabilityOfFalseAlarm, 1 / alpha) - 1);
 	}
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return pow(valueToTest / gamma + 1, alpha);
+	}
+
 private:
 	double alpha;
 	double gamma;
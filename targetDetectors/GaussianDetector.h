@@ -9,6 +9,7 @@ using namespace std;
 
 class GaussianDetector : public Detector {
 public:
+	virtual bool supportsFalseAlarmProbability() const { return true; }
 
 protected:
 	double mu;
@@ -35,6 +36,11 @@ protected:
 		return (1.414213562373095 * sigma * inverseCompErrorFunc(2 * probabilityOfFalseAlarm) + mu);
 	}
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return 0.5 * erfc((valueToTest - mu) / (1.414213562373095 * sigma));
+	}
+
 private:
 
 };
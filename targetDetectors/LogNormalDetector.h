@@ -31,5 +31,10 @@ protected:
 		return (log(valueToTest) > threshold);
 	}
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return GaussianDetector::estimateTailProbability(log(valueToTest));
+	}
+
 private:
 };
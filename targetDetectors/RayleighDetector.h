@@ -8,6 +8,7 @@ using namespace std;
 
 class RayleighDetector : public Detector {
 public:
+	virtual bool supportsFalseAlarmProbability() const { return true; }
 
 protected:
 	virtual void estimatePdfParameters(double* clutterValues, const int numberOfClutterValues)
@@ -27,6 +28,11 @@ protected:
 		return sqrt(- 2 * b * b * log(probabilityOfFalseAlarm) );
 	}
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return exp(-valueToTest * valueToTest / (2 * b * b));
+	}
+
 private:
 	double b;
 };
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <fstream>
+#include <algorithm>
+#include <opencv2\opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+
+// one target pixel in image coordinates, probability is its false alarm probability (-1 if the detector does not provide it)
+struct TargetDetection {
+	int x;
+	int y;
+	double value;
+	float probability;
+
+	TargetDetection(int x = 0, int y = 0, double value = 0.0, float probability = -1.0f)
+	{
+		this->x = x;
+		this->y = y;
+		this->value = value;
+		this->probability = probability;
+	}
+
+	bool operator<(const TargetDetection& other) const
+	{
+		return (y < other.y || (y == other.y && x < other.x));
+	}
+};
+
+// sparse alternative to a full-size target map, detections are written as CSV (x,y,value,probability) or as a binary file
+// (int32 count followed by count records of int32 x, int32 y, float64 value, float32 probability, little endian)
+class TargetDetectionList {
+public:
+	// concatenates the per-thread buffers in raster order, so the result does not depend on the tile scheduling
+	static vector<TargetDetection> merge(vector<vector<TargetDetection>>& threadDetections)
+	{
+		size_t detectionCount = 0;
+		for (int i = 0; i < threadDetections.size(); i++) {
+			detectionCount += threadDetections[i].size();
+		}
+
+		vector<TargetDetection> detections;
+		detections.reserve(detectionCount);
+		for (int i = 0; i < threadDetections.size(); i++) {
+			detections.insert(detections.end(), threadDetections[i].begin(), threadDetections[i].end());
+		}
+
+		sort(detections.begin(), detections.end());
+
+		return detections;
+	}
+
+	// detections of a dense target map (non-zero pixels), for detectors that only produce target maps
+	static vector<TargetDetection> createFromTargetMap(Mat& targetMap, Mat& image)
+	{
+		vector<TargetDetection> detections;
+		for (int y = 0; y < targetMap.rows; y++) {
+			const unsigned char* trow = (unsigned char*)(targetMap.data + y * targetMap.step);
+
+			for (int x = 0; x < targetMap.cols; x++) {
+				if (trow[x] > 0) {
+					detections.push_back(TargetDetection(x, y, getPixelValue(image, x, y)));
+				}
+			}
+		}
+
+		return detections;
+	}
+
+	static double getPixelValue(Mat& image, int x, int y)
+	{
+		switch (image.depth())
+		{
+		case CV_8U:  return image.at<unsigned char>(y, x);
+		case CV_8S:  return image.at<char>(y, x);
+		case CV_16U: return image.at<unsigned short>(y, x);
+		case CV_16S: return image.at<short>(y, x);
+		case CV_32S: return image.at<int>(y, x);
+		case CV_32F: return image.at<float>(y, x);
+		case CV_64F: return image.at<double>(y, x);
+		default: return 0.0;
+		}
+	}
+
+	static bool isDetectionListFile(string fileName)
+	{
+		return (hasExtension(fileName, ".csv") || hasExtension(fileName, ".bin"));
+	}
+
+	// format is chosen by the extension, .csv is written as text and anything else as binary
+	static bool write(string fileName, const vector<TargetDetection>& detections)
+	{
+		return (hasExtension(fileName, ".csv") ? writeCSV(fileName, detections) : writeBinary(fileName, detections));
+	}
+
+	static bool writeCSV(string fileName, const vector<TargetDetection>& detections)
+	{
+		ofstream file(fileName);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file << "x,y,value,probability" << endl;
+		file.precision(9);
+		for (int i = 0; i < detections.size(); i++) {
+			const TargetDetection& detection = detections[i];
+			file << detection.x << "," << detection.y << "," << detection.value << "," << detection.probability << "\n";
+		}
+
+		return file.good();
+	}
+
+	static bool writeBinary(string fileName, const vector<TargetDetection>& detections)
+	{
+		ofstream file(fileName, ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		const int detectionCount = (int)detections.size();
+		file.write((const char*)&detectionCount, sizeof(int));
+		for (int i = 0; i < detections.size(); i++) {
+			const TargetDetection& detection = detections[i];
+			file.write((const char*)&detection.x, sizeof(int));
+			file.write((const char*)&detection.y, sizeof(int));
+			file.write((const char*)&detection.value, sizeof(double));
+			file.write((const char*)&detection.probability, sizeof(float));
+		}
+
+		return file.good();
+	}
+
+	static vector<TargetDetection> readBinary(string fileName)
+	{
+		vector<TargetDetection> detections;
+
+		ifstream file(fileName, ios::binary);
+		int detectionCount = 0;
+		if (!file.read((char*)&detectionCount, sizeof(int))) {
+			return detections;
+		}
+
+		detections.resize(max(detectionCount, 0));
+		for (int i = 0; i < detections.size() && file; i++) {
+			TargetDetection& detection = detections[i];
+			file.read((char*)&detection.x, sizeof(int));
+			file.read((char*)&detection.y, sizeof(int));
+			file.read((char*)&detection.value, sizeof(double));
+			file.read((char*)&detection.probability, sizeof(float));
+		}
+
+		return detections;
+	}
+
+private:
+	static bool hasExtension(const string& fileName, const string& extension)
+	{
+		if (fileName.size() < extension.size()) {
+			return false;
+		}
+
+		string fileExtension = fileName.substr(fileName.size() - extension.size());
+		transform(fileExtension.begin(), fileExtension.end(), fileExtension.begin(), ::tolower);
+
+		return (fileExtension == extension);
+	}
+
+};
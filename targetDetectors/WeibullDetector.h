@@ -6,6 +6,7 @@
 
 class WeibullDetector : public Detector {
 public:
+	virtual bool supportsFalseAlarmProbability() const { return true; }
 
 protected:
 	virtual void estimatePdfParameters(double* clutterValues, const int numberOfClutterValues)
@@ -21,6 +22,11 @@ protected:
 		return lambda*( pow(-log(probabilityOfFalseAlarm), 1/k) );
 	}
 
+	virtual double estimateTailProbability(const double valueToTest)
+	{
+		return exp(-pow(valueToTest / lambda, k));
+	}
+
 private:
 	double k;
 	double lambda;
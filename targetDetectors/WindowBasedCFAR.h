@@ -31,10 +31,7 @@ public:
 
 	virtual Mat execute(Mat image, double probabilityOfFalseAlarm, map<string, double>& parameters)
 	{
-		this->targetRadius = (int)getParameterValue(parameters, "WB-CFAR.targetRadius", 2);
-		this->guardRadius = (int)getParameterValue(parameters, "WB-CFAR.guardRadius", 3);
-		this->clutterRadius = (int)getParameterValue(parameters, "WB-CFAR.clutterRadius", 5);
-		this->osPercent = getParameterValue(parameters, "AC-CFAR.censoringPercentile", 99.0);
+		setParameters(parameters);
 
 		const bool usePowerImage = (clutterDistribution == G0);
 		if (usePowerImage) {
@@ -59,6 +56,42 @@ public:
 		return targetImage;
 	}
 
+	// empty if the CFAR type (calculateFalseAlarmProbability) or the clutter distribution (Detector::estimateTailProbability) does not provide probabilities
+	virtual Mat executeProbabilityMap(Mat image, map<string, double>& parameters)
+	{
+		setParameters(parameters);
+
+		Detector* detector = createDetector(clutterDistribution);
+		const bool isSupported = (supportsFalseAlarmProbability() && detector != NULL && detector->supportsFalseAlarmProbability());
+		removeDetectors(detector);
+
+		if (!isSupported) {
+			return Mat();
+		}
+
+		const bool usePowerImage = (clutterDistribution == G0);
+		if (usePowerImage) {
+			image.convertTo(image, CV_32F);
+			image = image.mul(image);
+		}
+
+		Mat probabilityMap(image.rows, image.cols, CV_32FC1);
+
+		switch (image.depth())
+		{
+		case CV_8U:  calculateProbabilities<unsigned char>(image, probabilityMap, clutterDistribution);		break;
+		case CV_8S:  calculateProbabilities<char>(image, probabilityMap, clutterDistribution);				break;
+		case CV_16U: calculateProbabilities<unsigned short>(image, probabilityMap, clutterDistribution);	break;
+		case CV_16S: calculateProbabilities<short>(image, probabilityMap, clutterDistribution);				break;
+		case CV_32S: calculateProbabilities<int>(image, probabilityMap, clutterDistribution);				break;
+		case CV_32F: calculateProbabilities<float>(image, probabilityMap, clutterDistribution);				break;
+		case CV_64F: calculateProbabilities<double>(image, probabilityMap, clutterDistribution);			break;
+		default: return Mat();
+		}
+
+		return probabilityMap;
+	}
+
 	virtual int getClutterArea(map<string, double>& parameters)
 	{
 		this->targetRadius = (int)parameters["WB-CFAR.targetRadius"];
@@ -96,6 +129,14 @@ protected:
 		return x * x;
 	}
 
+	void setParameters(map<string, double>& parameters)
+	{
+		this->targetRadius = (int)getParameterValue(parameters, "WB-CFAR.targetRadius", 2);
+		this->guardRadius = (int)getParameterValue(parameters, "WB-CFAR.guardRadius", 3);
+		this->clutterRadius = (int)getParameterValue(parameters, "WB-CFAR.clutterRadius", 5);
+		this->osPercent = getParameterValue(parameters, "AC-CFAR.censoringPercentile", 99.0);
+	}
+
 	template<typename T>
 	void detectTargets(Mat& image, Mat& targetImage, double probabilityOfFalseAlarm, ClutterDistribution clutterDistribution)
 	{
@@ -139,6 +180,48 @@ protected:
 		}
 	}
 
+	// same traversal as detectTargets, pixels that are not tested get probability 1
+	template<typename T>
+	void calculateProbabilities(Mat& image, Mat& probabilityMap, ClutterDistribution clutterDistribution)
+	{
+		const int threadCount = min(getThreadCount(), image.rows);
+
+		Detector* detector;
+		double* candidateRegion;
+		double* clutterRegion;
+		T* imageDataRow;
+		float* probabilityMapRow;
+		int x, y, numCandidatePixels, numClutterPixels, limit1, limit2, limit3, numRegion1, numRegion2, numRegion3, numRegion4;
+		#pragma omp parallel private(detector, candidateRegion, clutterRegion, limit1, limit2, limit3) num_threads(threadCount)
+		{
+			detector = createDetector(clutterDistribution);
+
+			createCFARRegions(candidateRegion, clutterRegion, limit1, limit2, limit3);
+
+			#pragma omp for private(x, y, numCandidatePixels, numClutterPixels, numRegion1, numRegion2, numRegion3, numRegion4, imageDataRow, probabilityMapRow)
+			for (y=0; y<image.rows; y++) {
+				imageDataRow = (T*)(image.data + y * image.step);
+				probabilityMapRow = (float*)(probabilityMap.data + y * probabilityMap.step);
+
+				for (x=0; x<image.cols; x++) {
+					probabilityMapRow[x] = 1.0f;
+
+					if (imageDataRow[x] > 0) {
+						numCandidatePixels = 0;
+						numClutterPixels = 0;
+						getRegionPixels<T>(image, x, y, candidateRegion, numCandidatePixels, clutterRegion, numClutterPixels, limit1, limit2, limit3, numRegion1, numRegion2, numRegion3, numRegion4);
+
+						probabilityMapRow[x] = (float)calculateFalseAlarmProbability(detector, candidateRegion, numCandidatePixels, clutterRegion, numClutterPixels, numRegion1, numRegion2, numRegion3, numRegion4);
+					}
+				}
+			}
+
+			removeCFARRegions(candidateRegion, clutterRegion);
+
+			removeDetectors(detector);
+		}
+	}
+
 	virtual Detector* createDetector(ClutterDistribution clutterDistribution)
 	{
 		switch (clutterDistribution )
@@ -424,4 +507,13 @@ protected:
 		return false;
 	}
 
+	// true if calculateFalseAlarmProbability is provided
+	virtual bool supportsFalseAlarmProbability() const { return false; }
+
+	// probability counterpart of checkTargetExistance, negative if not supported
+	virtual double calculateFalseAlarmProbability(Detector* detector, double* candidateRegion, const int& numCandidatePixels, double* clutterRegion, const int& numClutterPixels, const int& numRegion1, const int& numRegion2, const int& numRegion3, const int& numRegion4)
+	{
+		return -1.0;
+	}
+
 };